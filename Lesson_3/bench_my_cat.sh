@@ -0,0 +1,101 @@
+#!/usr/bin/env bash
+# bench_my_cat.sh — замеры my_cat: пропускная способность в канал по движкам, склейка мелких файлов (--batch)
+# и построчные фильтры -n/-A с разными сканерами
+# Запуск: bash bench_my_cat.sh /path/to/my_cat [SIZE_MB]
+
+set -euo pipefail
+
+BIN_INPUT="${1:-./my_cat}"
+case "$BIN_INPUT" in
+  /*) BIN="$BIN_INPUT" ;;
+  *)  BIN="$(pwd)/$BIN_INPUT" ;;
+esac
+SIZE_MB="${2:-2048}"
+RUNS=3
+
+WORK="/tmp/mycat_bench"
+rm -rf "$WORK" && mkdir -p "$WORK"
+cd "$WORK"
+
+now(){ date +%s.%N; }
+
+head -c $((SIZE_MB * 1024 * 1024)) /dev/urandom > big
+cat big > /dev/null  # файл в page cache: меряем вывод, а не диск
+
+# Потребители на другом конце канала. «my_cat» сам читает канал через splice
+# и отдаёт в /dev/null — так видно, сколько даёт zero-copy с обеих сторон.
+consumers=("cat >/dev/null" "wc -c >/dev/null" "'$BIN' >/dev/null")
+labels=("cat" "wc -c" "my_cat")
+
+printf "\n== my_cat big | consumer: %s MiB, лучший из %s прогонов, GB/s ==\n" "$SIZE_MB" "$RUNS"
+printf "%-10s" "engine"
+for l in "${labels[@]}"; do printf " %10s" "$l"; done
+printf "\n"
+
+modes=("--engine=rw" "--engine=sendfile" "--engine=splice" "--engine=auto" "--mmap")
+for mode in "${modes[@]}"; do
+  printf "%-10s" "${mode#--engine=}"
+  for c in "${consumers[@]}"; do
+    best=0
+    for _ in $(seq 1 "$RUNS"); do
+      t0=$(now)
+      eval "'$BIN' $mode big | $c"
+      t1=$(now)
+      best=$(awk -v b="$best" -v t="$(awk "BEGIN{print $t1 - $t0}")" -v s="$SIZE_MB" \
+             'BEGIN{g = s * 1048576 / t / 1e9; print (g > b ? g : b)}')
+    done
+    printf " %10.2f" "$best"
+  done
+  printf "\n"
+done
+
+# Корректность: содержимое через канал не должно меняться
+for mode in "${modes[@]}"; do
+  "$BIN" $mode big | cmp -s - big || { echo "MISMATCH: $mode" >&2; exit 1; }
+done
+
+# --- --batch: склейка множества мелких файлов (шарды логов) ---
+mkdir shards
+head -c $((20000 * 3000)) /dev/urandom | (cd shards && split -b 3000 -a 5 - s_)
+cat shards/* > shards.ref
+
+printf "\n== %s файлов по 3000 байт -> канал, лучший из %s прогонов ==\n" "$(ls shards | wc -l)" "$RUNS"
+printf "%-14s %10s %10s\n" "mode" "time, s" "files/s"
+for mode in "" "--batch=8" "--batch" "--batch=256"; do
+  best=999
+  for _ in $(seq 1 "$RUNS"); do
+    t0=$(now)
+    "$BIN" $mode shards/* | cat >/dev/null
+    t1=$(now)
+    best=$(awk -v b="$best" -v t="$(awk "BEGIN{print $t1 - $t0}")" 'BEGIN{print (t < b ? t : b)}')
+  done
+  "$BIN" $mode shards/* | cmp -s - shards.ref || { echo "MISMATCH: ${mode:-plain}" >&2; exit 1; }
+  printf "%-14s %10.3f %10.0f\n" "${mode:-plain}" "$best" "$(awk -v t="$best" 'BEGIN{print 20000 / t}')"
+done
+
+# --- -n/-A: построчные фильтры на логе, сканеры перевода строки ---
+# Строки по 60..160 байт, как в обычном логе приложения
+awk -v n=$((SIZE_MB * 1024 * 1024 / 110)) 'BEGIN{srand(1); s = sprintf("%160s", ""); gsub(/ /, "m", s);
+  for (i = 0; i < n; i++) printf "2026-01-01T00:00:%02d host app[%d]: %s\n", i % 60, i % 999, substr(s, 1, 20 + int(rand() * 100))}' > log
+cat log >/dev/null
+
+printf "\n== фильтры на логе %s байт -> /dev/null, лучший из %s прогонов, GB/s ==\n" "$(stat -c %s log)" "$RUNS"
+runs=("cat -n" "'$BIN' --engine=rw" "'$BIN' -n --scan=scalar" "'$BIN' -n --scan=sse2" "'$BIN' -n --scan=avx2"
+      "cat -A" "'$BIN' -A --scan=scalar" "'$BIN' -A --scan=sse2" "'$BIN' -A --scan=avx2")
+for r in "${runs[@]}"; do
+  eval "$r log >/dev/null 2>&1" || { printf "%-30s %10s\n" "${r//\'$BIN\'/my_cat}" "n/a"; continue; }
+  best=0
+  for _ in $(seq 1 "$RUNS"); do
+    t0=$(now)
+    eval "$r log >/dev/null"
+    t1=$(now)
+    best=$(awk -v b="$best" -v t="$(awk "BEGIN{print $t1 - $t0}")" -v s="$(stat -c %s log)" \
+           'BEGIN{g = s / t / 1e9; print (g > b ? g : b)}')
+  done
+  printf "%-30s %10.2f\n" "${r//\'$BIN\'/my_cat}" "$best"
+done
+for f in -n -A -ns; do
+  cmp -s <(cat $f log) <("$BIN" $f log) || { echo "MISMATCH: $f" >&2; exit 1; }
+done
+
+rm -rf "$WORK"
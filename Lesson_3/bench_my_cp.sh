@@ -0,0 +1,78 @@
+#!/usr/bin/env bash
+# bench_my_cp.sh — замеры для my_cp: движки на разных размерах файлов и разреженные копии
+# Запуск: bash bench_my_cp.sh /path/to/lesson3_my_cp [SIZE_MB]
+
+set -euo pipefail
+
+BIN_INPUT="${1:-./lesson3_my_cp}"
+case "$BIN_INPUT" in
+  /*) BIN="$BIN_INPUT" ;;
+  *)  BIN="$(pwd)/$BIN_INPUT" ;;
+esac
+SIZE_MB="${2:-1024}"
+
+WORK="/tmp/mycp_bench"
+rm -rf "$WORK" && mkdir -p "$WORK"
+cd "$WORK"
+
+now(){ date +%s.%N; }
+alloc_bytes(){ echo $(( $(stat -c %b "$1") * $(stat -c %B "$1") )); }
+# Сбросить page cache, чтобы прогоны были честными (нужен root; иначе — как есть)
+drop_caches(){ sync; echo 3 > /proc/sys/vm/drop_caches 2>/dev/null || true; }
+
+# --- Движки на разных распределениях размеров (--stats) ---
+# tiny  — много крошечных файлов: упор в open/create/close
+# mixed — от 1 KiB до 4 MiB вперемешку
+# huge  — пара больших файлов: упор в перенос данных
+mkdir -p dist/tiny dist/mixed dist/huge
+head -c $((4000 * 1024)) /dev/urandom > blob && (cd dist/tiny && split -b 1K -a 4 ../../blob t_) && rm blob
+for i in $(seq 1 300); do
+  head -c $(( (RANDOM * 32768 + RANDOM) % (4 * 1024 * 1024) + 1024 )) /dev/urandom > "dist/mixed/m_$i"
+done
+for i in 1 2; do
+  head -c $((SIZE_MB / 2 * 1024 * 1024)) /dev/urandom > "dist/huge/h_$i"
+done
+
+printf "\n== engines: files/s, MB/s и время фаз (сумма по потокам) ==\n"
+printf "%-6s %-16s %4s %10s %10s %8s %8s %8s %8s\n" \
+  "set" "engine" "-j" "files/s" "MB/s" "open,s" "stat,s" "copy,s" "close,s"
+for set in tiny mixed huge; do
+  for jobs in 1 4; do
+    for eng in copy_file_range sendfile rw auto; do
+      rm -rf "out_$set"
+      drop_caches
+      st=$("$BIN" --stats -r -j "$jobs" --engine="$eng" "dist/$set" "out_$set" 2>&1 >/dev/null)
+      diff -r "dist/$set" "out_$set" >/dev/null || { echo "MISMATCH: $set/$eng" >&2; exit 1; }
+      rate=$(printf '%s\n' "$st" | sed -n 's/.*: \([0-9.]*\) files\/s, \([0-9.]*\) MB\/s/\1 \2/p')
+      phases=$(printf '%s\n' "$st" | sed -n 's/.*open \([0-9.]*\) s, stat \([0-9.]*\) s, copy \([0-9.]*\) s, close \([0-9.]*\) s.*/\1 \2 \3 \4/p')
+      # shellcheck disable=SC2086
+      printf "%-6s %-16s %4s %10s %10s %8s %8s %8s %8s\n" "$set" "$eng" "$jobs" $rate $phases
+    done
+  done
+done
+rm -rf out_* dist
+
+# --- Разреженные файлы: сколько байт пишется и сколько места занимает копия ---
+# Образ SIZE_MB МиБ, данные — три куска по 4 МиБ (начало, середина, хвост), остальное дыры.
+truncate -s "${SIZE_MB}M" sparse.img
+for at in 0 $((SIZE_MB / 2)) $((SIZE_MB - 4)); do
+  dd if=/dev/urandom of=sparse.img bs=1M count=4 seek="$at" conv=notrunc status=none
+done
+
+printf "\n== sparse: %s MiB, данных %s байт ==\n" "$SIZE_MB" "$(alloc_bytes sparse.img)"
+printf "%-28s %10s %16s %16s\n" "mode" "time, s" "written, B" "allocated, B"
+
+# --sparse=never --engine=rw — прежний цикл read/write: пишет каждый байт, включая нули
+for mode in "never --engine=rw" "never" "auto" "always"; do
+  rm -f copy.img
+  sync
+  t0=$(now)
+  out=$("$BIN" -v --sparse=$mode sparse.img copy.img)
+  t1=$(now)
+  cmp -s sparse.img copy.img || { echo "MISMATCH for --sparse=$mode" >&2; exit 1; }
+  written=$(printf '%s\n' "$out" | sed -n 's/.*(sparse, \([0-9]*\) bytes written).*/\1/p')
+  [ -n "$written" ] || written=$(stat -c %s sparse.img)
+  printf "%-28s %10.3f %16s %16s\n" "--sparse=$mode" "$(awk "BEGIN{print $t1 - $t0}")" "$written" "$(alloc_bytes copy.img)"
+done
+
+rm -rf "$WORK"
@@ -1,29 +1,894 @@
+#define _GNU_SOURCE
 #include <unistd.h>
 #include <fcntl.h>
 #include <string.h>
 #include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <stdint.h>
+#include <limits.h>
+#include <sys/inotify.h>
+
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#ifdef __NR_io_uring_setup
+#define HAVE_IO_URING 1
+#endif
+#endif
+#endif
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 
 #define BUF_SIZE 65536
+#define KCOPY_CHUNK (1 << 30)  //    splice/sendfile
+#define BATCH_SLOT 65536       // --batch:   ;     
+#define BATCH_MAX 256          // --batch:  K
+#define BATCH_DEFAULT 32       // --batch  
+#define MMAP_WINDOW (64 << 20) // --mmap:      
+#define MMAP_MIN (1 << 20)     // --mmap:     
+#define FILTER_BUF (128 << 10) // -n/-s/-A:  
+#define OUT_SIZE (128 << 10)   // -n/-s/-A:  
 
-int copy_fd(int fd) {
+enum out_engine { ENGINE_AUTO, ENGINE_SPLICE, ENGINE_SENDFILE, ENGINE_RW };
+
+static const char* const engine_names[] = { "auto", "splice", "sendfile", "rw" };
+
+enum scan_kind { SCAN_AUTO, SCAN_AVX2, SCAN_SSE2, SCAN_SCALAR };
+
+static const char* const scan_names[] = { "auto", "avx2", "sse2", "scalar" };
+
+enum { OPT_ENGINE = 256, OPT_BATCH, OPT_MMAP, OPT_SCAN };
+
+static enum out_engine opt_engine = ENGINE_AUTO;  // --engine=
+static int opt_batch = 0;  // --batch[=K]:    , 0   
+static int opt_mmap = 0;   // --mmap:       
+static int opt_n = 0;      // -n/--number
+static int opt_s = 0;      // -s/--squeeze-blank
+static int opt_A = 0;      // -A/--show-all: ^X, M-X, $   
+static int opt_f = 0;      // -f/--follow:  EOF   (inotify)
+static int out_is_pipe = 0;  // stdout  : splice      
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [-nsAf] [--engine=auto|splice|sendfile|rw] [--batch[=K]] [--mmap] [FILE|-]...\n"
+                    "Filters: -n number lines, -s squeeze blank lines, -A show non-printing;\n"
+                    "  --scan=auto|avx2|sse2|scalar picks the newline scanner\n"
+                    "Follow: -f keeps printing data appended to FILEs (truncation and rotation aware)\n", prog);
+    exit(1);
+}
+
+static int parse_name(const char* s, const char* const* names, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (strcmp(s, names[i]) == 0) return (int)i;
+    }
+    return -1;
+}
+
+// ,       
+static int engine_unsupported(int err) {
+    return err == ENOSYS || err == EINVAL || err == EXDEV || err == EOPNOTSUPP || err == EBADF;
+}
+
+//   . 1    EOF, 0    
+//    , -1  .
+static int copy_kernel(int fd, enum out_engine e) {
+    int started = 0;
+    for (;;) {
+        ssize_t n = (e == ENGINE_SPLICE)
+            ? splice(fd, NULL, STDOUT_FILENO, NULL, KCOPY_CHUNK, SPLICE_F_MOVE | SPLICE_F_MORE)
+            : sendfile(STDOUT_FILENO, fd, NULL, KCOPY_CHUNK);
+        if (n > 0) { started = 1; continue; }
+        if (n == 0) return 1;
+        if (errno == EINTR) continue;
+        if (!started && engine_unsupported(errno)) return 0;
+        perror(engine_names[e]);
+        return -1;
+    }
+}
+
+static int copy_rw(int fd) {
     char buf[BUF_SIZE];
     ssize_t n;
-    while ((n = read(fd, buf, sizeof buf)) > 0) {
-        if (write(STDOUT_FILENO, buf, n) != n) {
-            perror("write");
-            return 1;
+    for (;;) {
+        n = read(fd, buf, sizeof buf);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        ssize_t off = 0;
+        while (off < n) {
+            ssize_t w = write(STDOUT_FILENO, buf + off, n - off);
+            if (w < 0 && errno == EINTR) continue;
+            if (w < 0) { perror("write"); return 1; }
+            off += w;
         }
     }
     if (n < 0) { perror("read"); return 1; }
     return 0;
 }
 
+// --mmap: write()          user-space.
+//     MMAP_WINDOW;    ,
+//  RSS     .        
+//   write(),        EFAULT,   SIGBUS.
+//  0    fd     (  ,
+//    )   ; -1  .
+static int copy_mmap(int fd, const struct stat* st) {
+    off_t pos = lseek(fd, 0, SEEK_CUR);
+    if (pos < 0 || st->st_size - pos < MMAP_MIN) return 0;
+    off_t page = (off_t)sysconf(_SC_PAGESIZE);
+    off_t end = st->st_size;
+    while (pos < end) {
+        off_t base = pos & ~(page - 1);
+        size_t maplen = (size_t)(end - base < MMAP_WINDOW ? end - base : MMAP_WINDOW);
+        char* map = mmap(NULL, maplen, PROT_READ, MAP_SHARED, fd, base);
+        if (map == MAP_FAILED) break;  //    mmap   
+        (void)madvise(map, maplen, MADV_SEQUENTIAL);
+
+        char* p = map + (pos - base);
+        size_t left = maplen - (size_t)(pos - base);
+        while (left > 0) {
+            ssize_t w = write(STDOUT_FILENO, p, left);
+            if (w < 0 && errno == EINTR) continue;
+            if (w < 0 && errno == EFAULT) { end = pos; break; }  //  
+            if (w < 0) { perror("write"); munmap(map, maplen); return -1; }
+            p += w;
+            left -= (size_t)w;
+            pos += w;
+        }
+        munmap(map, maplen);
+    }
+    if (lseek(fd, pos, SEEK_SET) < 0) { perror("lseek"); return -1; }
+    return 0;
+}
+
+// ---- -n, -s, -A:   ----
+//
+//     ( ,   -A  
+//  )      .  
+//    32 (AVX2)  16 (SSE2)   ,  
+//      memcpy,     .
+
+//  '\n'  [p, end)  end
+static const char* scan_nl_scalar(const char* p, const char* end) {
+    const char* q = memchr(p, '\n', (size_t)(end - p));
+    return q ? q : end;
+}
+
+//    0x20..0x7e ( -A: \n, \t, , DEL,  )
+static const char* scan_special_scalar(const char* p, const char* end) {
+    for (; p < end; p++) {
+        unsigned char c = (unsigned char)*p;
+        if (c < 0x20 || c > 0x7e) break;
+    }
+    return p;
+}
+
+#if defined(__x86_64__)
+static const char* scan_nl_sse2(const char* p, const char* end) {
+    const __m128i nl = _mm_set1_epi8('\n');
+    for (; end - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        unsigned m = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl));
+        if (m) return p + __builtin_ctz(m);
+    }
+    return scan_nl_scalar(p, end);
+}
+
+//  ,    [0x20, 0x7e]   
+static const char* scan_special_sse2(const char* p, const char* end) {
+    const __m128i lo = _mm_set1_epi8(0x20), hi = _mm_set1_epi8(0x7e);
+    for (; end - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        __m128i ok = _mm_cmpeq_epi8(v, _mm_min_epu8(_mm_max_epu8(v, lo), hi));
+        unsigned m = ~(unsigned)_mm_movemask_epi8(ok) & 0xffffu;
+        if (m) return p + __builtin_ctz(m);
+    }
+    return scan_special_scalar(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char* scan_nl_avx2(const char* p, const char* end) {
+    const __m256i nl = _mm256_set1_epi8('\n');
+    for (; end - p >= 32; p += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        unsigned m = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl));
+        if (m) return p + __builtin_ctz(m);
+    }
+    return scan_nl_sse2(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char* scan_special_avx2(const char* p, const char* end) {
+    const __m256i lo = _mm256_set1_epi8(0x20), hi = _mm256_set1_epi8(0x7e);
+    for (; end - p >= 32; p += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        __m256i ok = _mm256_cmpeq_epi8(v, _mm256_min_epu8(_mm256_max_epu8(v, lo), hi));
+        unsigned m = ~(unsigned)_mm256_movemask_epi8(ok);
+        if (m) return p + __builtin_ctz(m);
+    }
+    return scan_special_sse2(p, end);
+}
+#endif
+
+static const char* (*scan_nl)(const char*, const char*) = scan_nl_scalar;
+static const char* (*scan_special)(const char*, const char*) = scan_special_scalar;
+
+//  :       --scan=
+static int scan_init(enum scan_kind k) {
+#if defined(__x86_64__)
+    if (k == SCAN_AUTO) k = __builtin_cpu_supports("avx2") ? SCAN_AVX2 : SCAN_SSE2;
+    if (k == SCAN_AVX2 && !__builtin_cpu_supports("avx2")) return -1;
+    if (k == SCAN_AVX2) { scan_nl = scan_nl_avx2; scan_special = scan_special_avx2; }
+    if (k == SCAN_SSE2) { scan_nl = scan_nl_sse2; scan_special = scan_special_sse2; }
+#else
+    if (k == SCAN_AVX2 || k == SCAN_SSE2) return -1;
+#endif
+    return 0;
+}
+
+//   :   (, ^X)    write
+static char out_buf[OUT_SIZE];
+static size_t out_len = 0;
+
+static int out_flush(void) {
+    size_t off = 0;
+    while (off < out_len) {
+        ssize_t w = write(STDOUT_FILENO, out_buf + off, out_len - off);
+        if (w < 0 && errno == EINTR) continue;
+        if (w < 0) { perror("write"); out_len = 0; return 1; }
+        off += (size_t)w;
+    }
+    out_len = 0;
+    return 0;
+}
+
+static int out_put_slow(const char* p, size_t n) {
+    if (out_flush() != 0) return 1;
+    if (n >= sizeof out_buf) {  //     
+        size_t off = 0;
+        while (off < n) {
+            ssize_t w = write(STDOUT_FILENO, p + off, n - off);
+            if (w < 0 && errno == EINTR) continue;
+            if (w < 0) { perror("write"); return 1; }
+            off += (size_t)w;
+        }
+        return 0;
+    }
+    memcpy(out_buf + out_len, p, n);
+    out_len += n;
+    return 0;
+}
+
+static inline int out_put(const char* p, size_t n) {
+    if (out_len + n > sizeof out_buf) return out_put_slow(p, n);
+    memcpy(out_buf + out_len, p, n);
+    out_len += n;
+    return 0;
+}
+
+//    -n    "     1\t"  
+//      snprintf   .    6,   cat.
+static char num_buf[32] = "                         0\t";
+static char* num_first = num_buf + 25;             //  
+static char* const num_last = num_buf + 25;        //  
+
+static int put_line_number(void) {
+    char* d = num_last;
+    while (*d == '9') *d-- = '0';
+    if (*d == ' ') *d = '1';
+    else (*d)++;
+    if (d < num_first) num_first = d;
+    char* from = num_first < num_last - 5 ? num_first : num_last - 5;
+    return out_put(from, (size_t)(num_last + 2 - from));
+}
+
+// -A: ^X  , M-   , ^?  DEL; '\n' -> "$\n"
+static int put_escaped(unsigned char c) {
+    char tmp[4];
+    size_t n = 0;
+    if (c >= 0x80) { tmp[n++] = 'M'; tmp[n++] = '-'; c -= 0x80; }
+    if (c < 0x20) { tmp[n++] = '^'; tmp[n++] = (char)(c + 0x40); }
+    else if (c == 0x7f) { tmp[n++] = '^'; tmp[n++] = '?'; }
+    else tmp[n++] = (char)c;
+    return out_put(tmp, n);
+}
+
+//     read()      cat
+static int at_line_start = 1;
+static int prev_blank = 0;
+
+static int filter_chunk(const char* p, const char* end) {
+    while (p < end) {
+        if (at_line_start) {
+            if (*p == '\n') {  //  
+                p++;
+                if (opt_s && prev_blank) continue;
+                prev_blank = 1;
+                if ((opt_n && put_line_number() != 0) || out_put(opt_A ? "$\n" : "\n", opt_A ? 2 : 1) != 0)
+                    return 1;
+                continue;
+            }
+            prev_blank = 0;
+            at_line_start = 0;
+            if (opt_n && put_line_number() != 0) return 1;
+        }
+        if (!opt_A) {
+            const char* nl = scan_nl(p, end);
+            if (nl == end) return out_put(p, (size_t)(end - p));
+            if (out_put(p, (size_t)(nl + 1 - p)) != 0) return 1;
+            p = nl + 1;
+            at_line_start = 1;
+            continue;
+        }
+        const char* q = scan_special(p, end);
+        if (out_put(p, (size_t)(q - p)) != 0) return 1;
+        p = q;
+        if (p == end) break;
+        unsigned char c = (unsigned char)*p++;
+        if (c == '\n') {
+            if (out_put("$\n", 2) != 0) return 1;
+            at_line_start = 1;
+        }
+        else if (put_escaped(c) != 0) return 1;
+    }
+    return 0;
+}
+
+static int copy_filter(int fd, int interactive) {
+    static char buf[FILTER_BUF];
+    ssize_t n;
+    for (;;) {
+        n = read(fd, buf, sizeof buf);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        if (filter_chunk(buf, buf + n) != 0) return 1;
+        //    tty    ,     
+        if (interactive && out_flush() != 0) return 1;
+    }
+    if (n < 0) { out_flush(); perror("read"); return 1; }
+    return out_flush();
+}
+
+// splice      , sendfile     ,
+//  .   --engine   .
+int copy_fd(int fd) {
+    struct stat st;
+    int in_is_pipe = 0, in_is_reg = 0;
+    if (fstat(fd, &st) == 0) {
+        in_is_pipe = S_ISFIFO(st.st_mode);
+        in_is_reg = S_ISREG(st.st_mode);
+    }
+
+    if (opt_n || opt_s || opt_A) return copy_filter(fd, !in_is_reg);
+    if (opt_mmap && in_is_reg && copy_mmap(fd, &st) != 0) return 1;
+
+    if (opt_engine == ENGINE_RW) return copy_rw(fd);
+    if (opt_engine != ENGINE_AUTO) {
+        int r = copy_kernel(fd, opt_engine);
+        if (r == 0) perror(engine_names[opt_engine]);
+        return r > 0 ? 0 : 1;
+    }
+
+    int r = 0;
+    if (out_is_pipe || in_is_pipe) r = copy_kernel(fd, ENGINE_SPLICE);
+    if (r == 0 && in_is_reg) r = copy_kernel(fd, ENGINE_SENDFILE);
+    if (r != 0) return r > 0 ? 0 : 1;
+    return copy_rw(fd);
+}
+
+// ---- --batch:        ----
+//
+//  K          
+// ,      stdout  writev().  io_uring  
+//      K :   (   ),
+//     statx, writev.  io_uring   open/fstat/read/close,
+//     writev  . ,     (  ),
+//   copy_fd()   ,   .
+
+struct slot {
+    const char* path;
+    int fd;
+    int err;       // errno open/read; 0    
+    ssize_t len;   //    buf
+    int whole;     //  buf    EOF   
+    char* buf;
+    struct statx stx;
+};
+
+struct batch {
+    int k;
+    struct slot* s;
+    char* mem;                 // k   BATCH_SLOT
+    int defer[BATCH_MAX];      // ,     
+    int n_defer;
+#ifdef HAVE_IO_URING
+    int uring;
+    int fd;
+    unsigned *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe* sqes;
+    struct io_uring_cqe* cqes;
+    void* sq_map;
+    void* cq_map;
+    size_t sq_map_sz, cq_map_sz, sqes_sz;
+#endif
+};
+
+#ifdef HAVE_IO_URING
+#define TAG_STATX (1ULL << 32)
+#define TAG_CLOSE (2ULL << 32)
+
+static int uring_init(struct batch* b) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof p);
+    b->fd = (int)syscall(__NR_io_uring_setup, 2 * b->k, &p);
+    if (b->fd < 0) return -1;
+    //     (off = -1)  OPENAT/STATX/CLOSE   5.6 
+    if (!(p.features & IORING_FEAT_RW_CUR_POS)) { close(b->fd); return -1; }
+
+    b->sq_map_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    b->cq_map_sz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (b->cq_map_sz > b->sq_map_sz) b->sq_map_sz = b->cq_map_sz;
+        b->cq_map_sz = b->sq_map_sz;
+    }
+    b->sq_map = mmap(NULL, b->sq_map_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     b->fd, IORING_OFF_SQ_RING);
+    if (b->sq_map == MAP_FAILED) { close(b->fd); return -1; }
+    b->cq_map = b->sq_map;
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP)) {
+        b->cq_map = mmap(NULL, b->cq_map_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         b->fd, IORING_OFF_CQ_RING);
+        if (b->cq_map == MAP_FAILED) { munmap(b->sq_map, b->sq_map_sz); close(b->fd); return -1; }
+    }
+    b->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+    b->sqes = mmap(NULL, b->sqes_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   b->fd, IORING_OFF_SQES);
+    if (b->sqes == MAP_FAILED) {
+        if (b->cq_map != b->sq_map) munmap(b->cq_map, b->cq_map_sz);
+        munmap(b->sq_map, b->sq_map_sz);
+        close(b->fd);
+        return -1;
+    }
+
+    char* sq = b->sq_map;
+    char* cq = b->cq_map;
+    b->sq_tail = (unsigned*)(sq + p.sq_off.tail);
+    b->sq_mask = (unsigned*)(sq + p.sq_off.ring_mask);
+    b->sq_array = (unsigned*)(sq + p.sq_off.array);
+    b->cq_head = (unsigned*)(cq + p.cq_off.head);
+    b->cq_tail = (unsigned*)(cq + p.cq_off.tail);
+    b->cq_mask = (unsigned*)(cq + p.cq_off.ring_mask);
+    b->cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+    return 0;
+}
+
+static struct io_uring_sqe* uring_sqe(struct batch* b, unsigned* queued) {
+    unsigned tail = *b->sq_tail + *queued;
+    unsigned idx = tail & *b->sq_mask;
+    struct io_uring_sqe* sqe = &b->sqes[idx];
+    memset(sqe, 0, sizeof *sqe);
+    b->sq_array[idx] = idx;
+    (*queued)++;
+    return sqe;
+}
+
+//   queued        io_uring_enter
+static int uring_run(struct batch* b, unsigned queued) {
+    __atomic_store_n(b->sq_tail, *b->sq_tail + queued, __ATOMIC_RELEASE);
+    unsigned submitted = 0, done = 0;
+    while (done < queued) {
+        long n = syscall(__NR_io_uring_enter, b->fd, queued - submitted, queued - done,
+                         IORING_ENTER_GETEVENTS, NULL, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return -1;
+        submitted += (unsigned)n;
+        unsigned head = *b->cq_head, tail = __atomic_load_n(b->cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++, done++) {
+            struct io_uring_cqe* cqe = &b->cqes[head & *b->cq_mask];
+            unsigned long long tag = cqe->user_data;
+            if (tag & TAG_CLOSE) continue;
+            struct slot* s = &b->s[tag & 0xffffffffULL];
+            if (tag & TAG_STATX) {
+                if (cqe->res < 0) s->stx.stx_mask = 0;  //      
+            }
+            else if (s->fd < 0 && !s->err) {  // OPENAT
+                if (cqe->res < 0) s->err = -cqe->res;
+                else s->fd = cqe->res;
+            }
+            else if (cqe->res < 0) s->err = -cqe->res;  // READ
+            else s->len = cqe->res;
+        }
+        __atomic_store_n(b->cq_head, head, __ATOMIC_RELEASE);
+    }
+    return 0;
+}
+
+static int batch_fill_uring(struct batch* b, int n) {
+    unsigned q = 0;
+    for (int i = 0; i < b->n_defer; i++) {
+        struct io_uring_sqe* sqe = uring_sqe(b, &q);
+        sqe->opcode = IORING_OP_CLOSE;
+        sqe->fd = b->defer[i];
+        sqe->user_data = TAG_CLOSE;
+    }
+    b->n_defer = 0;
+    for (int i = 0; i < n; i++) {
+        struct io_uring_sqe* sqe = uring_sqe(b, &q);
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = (unsigned long long)(uintptr_t)b->s[i].path;
+        sqe->open_flags = O_RDONLY | O_CLOEXEC;
+        sqe->user_data = (unsigned long long)i;
+    }
+    if (uring_run(b, q) != 0) return -1;
+
+    q = 0;
+    for (int i = 0; i < n; i++) {
+        struct slot* s = &b->s[i];
+        if (s->fd < 0) continue;
+        struct io_uring_sqe* sqe = uring_sqe(b, &q);
+        sqe->opcode = IORING_OP_STATX;
+        sqe->fd = s->fd;
+        sqe->addr = (unsigned long long)(uintptr_t)"";
+        sqe->len = STATX_TYPE | STATX_SIZE;
+        sqe->statx_flags = AT_EMPTY_PATH;
+        sqe->off = (unsigned long long)(uintptr_t)&s->stx;  // addr2:   statx
+        sqe->user_data = TAG_STATX | (unsigned long long)i;
+
+        sqe = uring_sqe(b, &q);
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = s->fd;
+        sqe->addr = (unsigned long long)(uintptr_t)s->buf;
+        sqe->len = BATCH_SLOT;
+        sqe->off = (unsigned long long)-1;  //   ,  read()
+        sqe->user_data = (unsigned long long)i;
+    }
+    return uring_run(b, q);
+}
+#endif
+
+static void batch_fill_sync(struct batch* b, int n) {
+    for (int i = 0; i < b->n_defer; i++) close(b->defer[i]);
+    b->n_defer = 0;
+    for (int i = 0; i < n; i++) {
+        b->s[i].fd = open(b->s[i].path, O_RDONLY | O_CLOEXEC);
+        if (b->s[i].fd < 0) b->s[i].err = errno;
+    }
+    for (int i = 0; i < n; i++) {
+        struct slot* s = &b->s[i];
+        if (s->fd < 0) continue;
+        struct stat st;
+        if (fstat(s->fd, &st) == 0) {
+            s->stx.stx_mask = STATX_TYPE | STATX_SIZE;
+            s->stx.stx_mode = (unsigned short)st.st_mode;
+            s->stx.stx_size = (unsigned long long)st.st_size;
+        }
+        ssize_t r;
+        while ((r = read(s->fd, s->buf, BATCH_SLOT)) < 0 && errno == EINTR) {}
+        if (r < 0) s->err = errno;
+        else s->len = r;
+    }
+}
+
+static int writev_all(struct iovec* iov, int cnt) {
+    while (cnt > 0) {
+        ssize_t w = writev(STDOUT_FILENO, iov, cnt);
+        if (w < 0 && errno == EINTR) continue;
+        if (w < 0) { perror("write"); return 1; }
+        while (cnt > 0 && (size_t)w >= iov->iov_len) { w -= (ssize_t)iov->iov_len; iov++; cnt--; }
+        if (cnt > 0) { iov->iov_base = (char*)iov->iov_base + w; iov->iov_len -= (size_t)w; }
+    }
+    return 0;
+}
+
+//     :       writev
+static int batch_emit(struct batch* b, int n) {
+    struct iovec iov[BATCH_MAX];
+    int cnt = 0, status = 0;
+    for (int i = 0; i < n; i++) {
+        struct slot* s = &b->s[i];
+        //  ,     ,    
+        s->whole = !s->err && (s->stx.stx_mask & STATX_TYPE) && S_ISREG(s->stx.stx_mode) &&
+                   (s->stx.stx_mask & STATX_SIZE) && (unsigned long long)s->len == s->stx.stx_size;
+        if (s->whole) {
+            if (s->len > 0) iov[cnt++] = (struct iovec){ s->buf, (size_t)s->len };
+            b->defer[b->n_defer++] = s->fd;
+            continue;
+        }
+        if (cnt) { status |= writev_all(iov, cnt); cnt = 0; }
+        if (s->err) {
+            fprintf(stderr, "%s: %s\n", s->path, strerror(s->err));
+            status = 1;
+        }
+        else {
+            struct iovec one = { s->buf, (size_t)s->len };
+            if (s->len > 0) status |= writev_all(&one, 1);
+            status |= copy_fd(s->fd);
+        }
+        if (s->fd >= 0) close(s->fd);
+    }
+    if (cnt) status |= writev_all(iov, cnt);
+    return status;
+}
+
+static int batch_run(struct batch* b, char** paths, int n) {
+    for (int i = 0; i < n; i++) {
+        struct slot* s = &b->s[i];
+        memset(&s->stx, 0, sizeof s->stx);
+        s->path = paths[i];
+        s->fd = -1;
+        s->err = 0;
+        s->len = 0;
+    }
+#ifdef HAVE_IO_URING
+    if (b->uring && batch_fill_uring(b, n) != 0) {
+        //        -
+        perror("io_uring_enter");
+        for (int i = 0; i < n; i++) {
+            if (b->s[i].fd >= 0) close(b->s[i].fd);
+            b->s[i].fd = -1;
+            b->s[i].err = 0;
+        }
+        b->uring = 0;
+    }
+    if (!b->uring) batch_fill_sync(b, n);
+#else
+    batch_fill_sync(b, n);
+#endif
+    return batch_emit(b, n);
+}
+
+//   :  io_uring     
+static void batch_close_deferred(struct batch* b) {
+#ifdef HAVE_IO_URING
+    if (b->uring && b->n_defer > 0) {
+        unsigned q = 0;
+        for (int i = 0; i < b->n_defer; i++) {
+            struct io_uring_sqe* sqe = uring_sqe(b, &q);
+            sqe->opcode = IORING_OP_CLOSE;
+            sqe->fd = b->defer[i];
+            sqe->user_data = TAG_CLOSE;
+        }
+        if (uring_run(b, q) == 0) { b->n_defer = 0; return; }
+    }
+#endif
+    for (int i = 0; i < b->n_defer; i++) close(b->defer[i]);
+    b->n_defer = 0;
+}
+
+static int cat_batched(char** args, int nargs) {
+    struct batch b;
+    memset(&b, 0, sizeof b);
+    b.k = opt_batch;
+    b.s = calloc((size_t)b.k, sizeof *b.s);
+    b.mem = malloc((size_t)b.k * BATCH_SLOT);
+    if (!b.s || !b.mem) { perror("malloc"); free(b.s); free(b.mem); return 1; }
+    for (int i = 0; i < b.k; i++) b.s[i].buf = b.mem + (size_t)i * BATCH_SLOT;
+#ifdef HAVE_IO_URING
+    b.uring = uring_init(&b) == 0;
+#endif
+
+    int status = 0;
+    for (int i = 0; i < nargs;) {
+        if (strcmp(args[i], "-") == 0) {
+            status |= copy_fd(STDIN_FILENO);
+            i++;
+            continue;
+        }
+        int n = 0;
+        while (n < b.k && i + n < nargs && strcmp(args[i + n], "-") != 0) n++;
+        status |= batch_run(&b, args + i, n);
+        i += n;
+    }
+
+    batch_close_deferred(&b);
+#ifdef HAVE_IO_URING
+    if (b.uring) {
+        munmap(b.sqes, b.sqes_sz);
+        if (b.cq_map != b.sq_map) munmap(b.cq_map, b.cq_map_sz);
+        munmap(b.sq_map, b.sq_map_sz);
+        close(b.fd);
+    }
+#endif
+    free(b.mem);
+    free(b.s);
+    return status;
+}
+
+// ---- -f:    inotify ----
+//
+//       read()   inotify  
+//    .  IN_MODIFY    :  fd
+//     .     ,   .
+// IN_MOVE_SELF/IN_DELETE_SELF  :  fd   ,
+//          IN_CREATE/IN_MOVED_TO  .
+
+struct follow {
+    const char* path;
+    const char* name;   //   path      
+    char dir[PATH_MAX];
+    int fd;             // -1       
+    int wd;             //    
+    int dir_wd;         //   
+};
+
+//       ;   
+static int follow_drain(struct follow* f) {
+    struct stat st;
+    if (fstat(f->fd, &st) != 0) { perror(f->path); return 1; }
+    off_t pos = lseek(f->fd, 0, SEEK_CUR);
+    if (pos < 0) { perror(f->path); return 1; }
+    if (st.st_size < pos) {
+        fprintf(stderr, "%s: file truncated\n", f->path);
+        if (lseek(f->fd, 0, SEEK_SET) < 0) { perror(f->path); return 1; }
+    }
+    else if (st.st_size == pos) {
+        return 0;  //     (,   )
+    }
+    return copy_fd(f->fd);
+}
+
+//    (  )      
+static int follow_reopen(int ifd, struct follow* f) {
+    int fd = open(f->path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;  //       
+    struct stat a, b;
+    if (f->fd >= 0 && fstat(fd, &a) == 0 && fstat(f->fd, &b) == 0 && a.st_ino == b.st_ino && a.st_dev == b.st_dev) {
+        close(fd);
+        return 0;
+    }
+    int status = 0;
+    if (f->fd >= 0) {
+        status |= follow_drain(f);  // ,   
+        close(f->fd);
+        fprintf(stderr, "%s: file replaced, following the new one\n", f->path);
+    }
+    f->fd = fd;
+    f->wd = inotify_add_watch(ifd, f->path, IN_MODIFY | IN_MOVE_SELF | IN_DELETE_SELF);
+    if (f->wd < 0) perror(f->path);
+    return status | copy_fd(f->fd);
+}
+
+static int cat_follow(char** args, int nargs) {
+    int ifd = inotify_init1(IN_CLOEXEC);
+    if (ifd < 0) { perror("inotify_init1"); return 1; }
+    struct follow* fl = calloc((size_t)nargs, sizeof *fl);
+    if (!fl) { perror("calloc"); close(ifd); return 1; }
+
+    //     :    
+    // inotify_add_watch     
+    int status = 0, n = 0;
+    for (int i = 0; i < nargs; i++) {
+        if (strcmp(args[i], "-") == 0) continue;
+        struct follow* f = &fl[n];
+        f->path = args[i];
+        f->fd = open(args[i], O_RDONLY | O_CLOEXEC);
+        if (f->fd < 0) { perror(args[i]); status = 1; continue; }
+        const char* slash = strrchr(args[i], '/');
+        f->name = slash ? slash + 1 : args[i];
+        if (!slash) strcpy(f->dir, ".");
+        else snprintf(f->dir, sizeof f->dir, "%.*s", slash == args[i] ? 1 : (int)(slash - args[i]), args[i]);
+        f->wd = inotify_add_watch(ifd, f->path, IN_MODIFY | IN_MOVE_SELF | IN_DELETE_SELF);
+        f->dir_wd = inotify_add_watch(ifd, f->dir, IN_CREATE | IN_MOVED_TO | IN_MASK_ADD);
+        if (f->wd < 0 || f->dir_wd < 0) perror(args[i]);
+        n++;
+    }
+    for (int i = 0, k = 0; i < nargs; i++) {
+        if (strcmp(args[i], "-") == 0) { status |= copy_fd(STDIN_FILENO); continue; }
+        if (k < n && fl[k].path == args[i]) status |= copy_fd(fl[k++].fd);
+    }
+
+    //    struct inotify_event      
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    while (n > 0) {
+        ssize_t len = read(ifd, buf, sizeof buf);
+        if (len < 0 && errno == EINTR) continue;
+        if (len <= 0) { perror("inotify"); status = 1; break; }
+        for (char* p = buf; p < buf + len;) {
+            const struct inotify_event* ev = (const struct inotify_event*)p;
+            p += sizeof *ev + ev->len;
+            for (int i = 0; i < n; i++) {
+                struct follow* f = &fl[i];
+                if (ev->wd == f->wd && f->fd >= 0) {
+                    if (ev->mask & IN_MODIFY) status |= follow_drain(f);
+                    if (ev->mask & (IN_MOVE_SELF | IN_DELETE_SELF)) {
+                        //     :   ,     
+                        inotify_rm_watch(ifd, f->wd);
+                        f->wd = -1;
+                        status |= follow_reopen(ifd, f);
+                    }
+                }
+                else if (ev->wd == f->dir_wd && ev->len && strcmp(ev->name, f->name) == 0) {
+                    status |= follow_reopen(ifd, f);
+                }
+            }
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        if (fl[i].fd >= 0) close(fl[i].fd);
+    }
+    free(fl);
+    close(ifd);
+    return status;
+}
+
 int main(int argc, char** argv) {
-    if (argc == 1) return copy_fd(STDIN_FILENO);
+    static struct option long_opts[] = {
+        {"engine", required_argument, 0, OPT_ENGINE},
+        {"batch",  optional_argument, 0, OPT_BATCH},
+        {"mmap",   no_argument,       0, OPT_MMAP},
+        {"number",        no_argument,       0, 'n'},
+        {"squeeze-blank", no_argument,       0, 's'},
+        {"show-all",      no_argument,       0, 'A'},
+        {"follow",        no_argument,       0, 'f'},
+        {"scan",          required_argument, 0, OPT_SCAN},
+        {0, 0, 0, 0}
+    };
+
+    enum scan_kind scan = SCAN_AUTO;
+    int ch;
+    while ((ch = getopt_long(argc, argv, "nsAf", long_opts, NULL)) != -1) {
+        switch (ch) {
+        case 'n': opt_n = 1; break;
+        case 's': opt_s = 1; break;
+        case 'A': opt_A = 1; break;
+        case 'f': opt_f = 1; break;
+        case OPT_ENGINE: {
+            int e = parse_name(optarg, engine_names, sizeof engine_names / sizeof engine_names[0]);
+            if (e < 0) {
+                fprintf(stderr, "unknown engine '%s'\n", optarg);
+                usage(argv[0]);
+            }
+            opt_engine = (enum out_engine)e;
+            break;
+        }
+        case OPT_BATCH: {
+            char* end = NULL;
+            long v = optarg ? strtol(optarg, &end, 10) : BATCH_DEFAULT;
+            if ((optarg && *end != '\0') || v < 1 || v > BATCH_MAX) {
+                fprintf(stderr, "invalid --batch value '%s' (1..%d)\n", optarg, BATCH_MAX);
+                usage(argv[0]);
+            }
+            opt_batch = (int)v;
+            break;
+        }
+        case OPT_MMAP: opt_mmap = 1; break;
+        case OPT_SCAN: {
+            int k = parse_name(optarg, scan_names, sizeof scan_names / sizeof scan_names[0]);
+            if (k < 0) {
+                fprintf(stderr, "unknown scanner '%s'\n", optarg);
+                usage(argv[0]);
+            }
+            scan = (enum scan_kind)k;
+            break;
+        }
+        default: usage(argv[0]);
+        }
+    }
+
+    if (scan_init(scan) != 0) {
+        fprintf(stderr, "scanner '%s' is not supported by this CPU\n", scan_names[scan]);
+        return 1;
+    }
+
+    struct stat st;
+    out_is_pipe = fstat(STDOUT_FILENO, &st) == 0 && S_ISFIFO(st.st_mode);
+
+    if (optind == argc) return copy_fd(STDIN_FILENO);
+    if (opt_f) return cat_follow(argv + optind, argc - optind);
+    //    stdout       
+    if (opt_batch && !(opt_n || opt_s || opt_A)) return cat_batched(argv + optind, argc - optind);
 
     int status = 0;
-    for (int i = 1; i < argc; i++) {
+    for (int i = optind; i < argc; i++) {
         if (strcmp(argv[i], "-") == 0) {
             status |= copy_fd(STDIN_FILENO);
             continue;
@@ -1,4 +1,4 @@
-#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -8,20 +8,177 @@
 #include <libgen.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/sendfile.h>
 #include <limits.h>
 #include <getopt.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/resource.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <aio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include <sys/xattr.h>
+
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#ifdef __NR_io_uring_setup
+#define HAVE_IO_URING 1
+#endif
+#endif
+#endif
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
 
 #define BUF_SIZE 65536
+#define KCOPY_CHUNK (1 << 30)  //    copy_file_range/sendfile
+#define MAX_JOBS 256           //   -j
+#define SPARSE_BLOCK 4096      //     --sparse=always
+#define DIRECT_CHUNK (1 << 20) // --direct:   
+#define DIRECT_SLOTS 8         // --direct:    =   
+#define DIRECT_ALIGN 4096      //      O_DIRECT
+#define RESUME_BLOCK ((off_t)64 << 20)  // --resume:   64 MiB
+#define JOURNAL_SUFFIX ".mycp-journal"
+
+#ifndef FICLONE
+#define FICLONE _IOW(0x94, 9, int)
+#endif
+
+enum copy_engine { ENGINE_AUTO, ENGINE_CFR, ENGINE_SENDFILE, ENGINE_RW };
+
+static const char* const engine_names[] = { "auto", "copy_file_range", "sendfile", "rw" };
+
+enum sparse_mode { SPARSE_AUTO, SPARSE_ALWAYS, SPARSE_NEVER };
+
+static const char* const sparse_names[] = { "auto", "always", "never" };
+
+enum reflink_mode { REFLINK_NEVER, REFLINK_AUTO, REFLINK_ALWAYS };
+
+static const char* const reflink_names[] = { "never", "auto", "always" };
+
+enum direct_mode { DIRECT_OFF, DIRECT_AUTO, DIRECT_URING, DIRECT_AIO };
+
+static const char* const direct_names[] = { "off", "auto", "io_uring", "aio" };
+
+enum resume_mode { RESUME_OFF, RESUME_OFFSETS, RESUME_CRC };
+
+static const char* const resume_names[] = { "off", "offsets", "crc32c" };
+
+enum verify_mode { VERIFY_OFF, VERIFY_XXH64, VERIFY_CRC32C };
+
+static const char* const verify_names[] = { "off", "xxh64", "crc32c" };
+
+enum { OPT_ENGINE = 256, OPT_SPARSE, OPT_REFLINK, OPT_DIRECT, OPT_NO_PREALLOC, OPT_DROP_BEHIND, OPT_STATS,
+       OPT_RESUME, OPT_VERIFY };
+
+// --stats:    
+enum phase { PH_OPEN, PH_STAT, PH_COPY, PH_CLOSE, PH_META, PH_COUNT };
+
+static const char* const phase_names[] = { "open", "stat", "copy", "close", "meta" };
 
 static int opt_f = 0;  // --force
 static int opt_i = 0;  // --interactive
 static int opt_v = 0;  // --verbose
+static enum copy_engine opt_engine = ENGINE_AUTO;  // --engine=
+static int opt_r = 0;  // -r/-R/--recursive
+static int opt_p = 0;  // -p/--preserve: , , , xattr
+static int opt_j = 1;  // -j N:   
+static enum sparse_mode opt_sparse = SPARSE_AUTO;  // --sparse=
+static enum reflink_mode opt_reflink = REFLINK_NEVER;  // --reflink[=]
+static enum direct_mode opt_direct = DIRECT_OFF;       // --direct[=]
+static int opt_prealloc = 1;        // --no-preallocate 
+static off_t opt_drop_window = 0;   // --drop-behind=SIZE, 0    page cache
+static int opt_stats = 0;           // --stats
+static enum resume_mode opt_resume = RESUME_OFF;  // --resume[=]
+static enum verify_mode opt_verify = VERIFY_OFF;  // --verify=ALG[,direct]
+static int opt_verify_direct = 0;                 // DEST   page cache
+
+//  --stats.       -j.
+static struct {
+    pthread_mutex_t mu;
+    double t[PH_COUNT];
+    long long files;
+    long long bytes;
+} stats = { PTHREAD_MUTEX_INITIALIZER, { 0 }, 0, 0 };
+
+//    .   ,
+//   -j  -v    .
+struct copy_result {
+    int status;   // 0  , -1   (   stderr)
+    int skipped;  // -i:    
+    int sparse;   //    ,  
+    int reflink;  // DEST   SRC (FICLONE),   
+    const char* direct;  // --direct:    (io_uring / posix aio)
+    double mbps;         // --direct:    
+    off_t drop_pos;      // --drop-behind:     
+    off_t drop_prev;     // --drop-behind:  DEST,   ,    
+    off_t resumed;       // --resume:    
+    struct hasher* hash; // --verify:  SRC,      (  copy_one)
+    int verified;        // --verify: DEST ,  
+    uint64_t digest;     // --verify:   
+    long long written;  //      DEST
+};
 
 static void usage(const char* prog) {
-    fprintf(stderr, "Usage:\n  %s [-fiv] SRC DEST\n  %s [-fiv] SRC... DIR\n", prog, prog);
+    fprintf(stderr, "Usage:\n  %s [-fivrp] [-j N] [--engine=E] [--sparse=WHEN] [--reflink[=WHEN]] [--direct[=IO]] SRC DEST\n"
+                    "  %s [-fivrp] [-j N] [--engine=E] [--sparse=WHEN] [--reflink[=WHEN]] [--direct[=IO]] SRC... DIR\n"
+                    "Engines: auto, copy_file_range, sendfile, rw\n"
+                    "Sparse: auto, always, never\n"
+                    "Reflink: never, auto, always (default with bare --reflink)\n"
+                    "Direct: --direct[=auto|io_uring|aio]  O_DIRECT + async pipeline\n"
+                    "Cache: --no-preallocate, --drop-behind=SIZE[K|M|G]\n"
+                    "Report: --stats  files/s, MB/s and per-phase times on stderr\n"
+                    "Resume: --resume[=offsets|crc32c]  continue an interrupted copy from its journal\n"
+                    "Verify: --verify=xxh64|crc32c[,direct]  hash while copying, then re-read DEST and compare\n", prog, prog);
     exit(1);
 }
 
+static int parse_name(const char* s, const char* const* names, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (strcmp(s, names[i]) == 0) return (int)i;
+    }
+    return -1;
+}
+
+//     K/M/G ( 1024)
+static int parse_size(const char* s, off_t* out) {
+    char* end;
+    errno = 0;
+    unsigned long long v = strtoull(s, &end, 10);
+    if (errno != 0 || end == s) return -1;
+    int shift = 0;
+    switch (*end) {
+    case 'K': case 'k': shift = 10; end++; break;
+    case 'M': case 'm': shift = 20; end++; break;
+    case 'G': case 'g': shift = 30; end++; break;
+    }
+    if (*end != '\0' || v > ((unsigned long long)LLONG_MAX >> shift)) return -1;
+    *out = (off_t)(v << shift);
+    return 0;
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// --stats:   *t      p (ph == NULL    )
+static void lap(double* t, double* ph, enum phase p) {
+    if (!opt_stats) return;
+    double n = now_sec();
+    if (ph) ph[p] += n - *t;
+    *t = n;
+}
+
 static int confirm_overwrite(const char* dst) {
     fprintf(stderr, "overwrite '%s'? [y/N] ", dst);
     int c = getchar();
@@ -46,78 +203,1913 @@ static const char* filename_of(const char* path, char* scratch, size_t cap) {
     return basename(scratch);
 }
 
-static int copy_file(const char* src, const char* dst) {
-    int in_fd = open(src, O_RDONLY);
-    if (in_fd < 0) { perror(src); return -1; }
+// ,       :
+//          .
+static int engine_unsupported(int err) {
+    return err == ENOSYS || err == EINVAL || err == EXDEV ||
+           err == EOPNOTSUPP || err == EBADF;
+}
+
+// --drop-behind:      page cache ,
+//        . pos   DEST .
+static void drop_behind(int in_fd, int out_fd, off_t pos, struct copy_result* res) {
+    if (opt_drop_window == 0 || pos - res->drop_pos < opt_drop_window) return;
+    off_t from = res->drop_pos;
+    (void)posix_fadvise(in_fd, from, pos - from, POSIX_FADV_DONTNEED);
+    //   DONTNEED  :     ,
+    //            
+    (void)sync_file_range(out_fd, from, pos - from, SYNC_FILE_RANGE_WRITE);
+    if (res->drop_prev < from) {
+        (void)sync_file_range(out_fd, res->drop_prev, from - res->drop_prev,
+                              SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+        (void)posix_fadvise(out_fd, res->drop_prev, from - res->drop_prev, POSIX_FADV_DONTNEED);
+    }
+    res->drop_prev = from;
+    res->drop_pos = pos;
+}
+
+static void drop_finish(int in_fd, int out_fd, struct copy_result* res) {
+    if (opt_drop_window == 0) return;
+    (void)posix_fadvise(in_fd, res->drop_pos, 0, POSIX_FADV_DONTNEED);
+    (void)sync_file_range(out_fd, res->drop_prev, 0,
+                          SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+    (void)posix_fadvise(out_fd, res->drop_prev, 0, POSIX_FADV_DONTNEED);
+}
+
+//         --drop-behind,    
+static size_t kernel_chunk(void) {
+    return (opt_drop_window > 0 && opt_drop_window < KCOPY_CHUNK) ? (size_t)opt_drop_window : KCOPY_CHUNK;
+}
+
+// ----  : CRC32C (--resume, --verify)  XXH64 (--verify) ----
+
+// CRC32C (Castagnoli).     , 
+static uint32_t crc32c_table[256];
+static pthread_once_t crc32c_once = PTHREAD_ONCE_INIT;
+
+static void crc32c_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) c = (c & 1) ? (c >> 1) ^ 0x82F63B78u : c >> 1;
+        crc32c_table[i] = c;
+    }
+}
+
+static uint32_t crc32c_sw(uint32_t crc, const unsigned char* p, size_t len) {
+    pthread_once(&crc32c_once, crc32c_init);
+    while (len--) crc = crc32c_table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    return crc;
+}
+
+#if defined(__x86_64__)
+// SSE4.2:  crc32   CRC32C,  8   
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw(uint32_t crc, const unsigned char* p, size_t len) {
+    uint64_t c = crc;
+    for (; len >= 8; p += 8, len -= 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        c = _mm_crc32_u64(c, v);
+    }
+    crc = (uint32_t)c;
+    for (; len > 0; p++, len--) crc = _mm_crc32_u8(crc, *p);
+    return crc;
+}
+#endif
+
+static uint32_t crc32c(uint32_t crc, const void* data, size_t len) {
+    crc = ~crc;
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("sse4.2")) return ~crc32c_hw(crc, data, len);
+#endif
+    return ~crc32c_sw(crc, data, len);
+}
+
+// XXH64 ().     8   
+//   ,  SIMD-   .
+#define XXH_P1 11400714785074694791ULL
+#define XXH_P2 14029467366897019727ULL
+#define XXH_P3 1609587929392839161ULL
+#define XXH_P4 9650029242287828579ULL
+#define XXH_P5 2870177450012600261ULL
+
+struct xxh64 {
+    uint64_t v[4];
+    uint64_t total;
+    unsigned char mem[32];
+    size_t memsize;
+};
+
+static uint64_t rotl64(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+static uint64_t xxh_round(uint64_t acc, uint64_t in) {
+    return rotl64(acc + in * XXH_P2, 31) * XXH_P1;
+}
+
+static uint64_t xxh_merge(uint64_t acc, uint64_t v) {
+    return (acc ^ xxh_round(0, v)) * XXH_P1 + XXH_P4;
+}
+
+static uint64_t read_le64(const unsigned char* p) { uint64_t v; memcpy(&v, p, 8); return v; }
+static uint32_t read_le32(const unsigned char* p) { uint32_t v; memcpy(&v, p, 4); return v; }
+
+static void xxh64_init(struct xxh64* s) {
+    memset(s, 0, sizeof *s);
+    s->v[0] = XXH_P1 + XXH_P2;
+    s->v[1] = XXH_P2;
+    s->v[2] = 0;
+    s->v[3] = -XXH_P1;
+}
+
+static void xxh64_stripe(struct xxh64* s, const unsigned char* p) {
+    for (int i = 0; i < 4; i++) s->v[i] = xxh_round(s->v[i], read_le64(p + 8 * i));
+}
+
+static void xxh64_update(struct xxh64* s, const void* data, size_t len) {
+    const unsigned char* p = data;
+    s->total += len;
+    if (s->memsize + len < 32) {
+        memcpy(s->mem + s->memsize, p, len);
+        s->memsize += len;
+        return;
+    }
+    if (s->memsize) {
+        size_t fill = 32 - s->memsize;
+        memcpy(s->mem + s->memsize, p, fill);
+        xxh64_stripe(s, s->mem);
+        p += fill;
+        len -= fill;
+        s->memsize = 0;
+    }
+    for (; len >= 32; p += 32, len -= 32) xxh64_stripe(s, p);
+    memcpy(s->mem, p, len);
+    s->memsize = len;
+}
+
+static uint64_t xxh64_digest(const struct xxh64* s) {
+    uint64_t h;
+    if (s->total >= 32) {
+        h = rotl64(s->v[0], 1) + rotl64(s->v[1], 7) + rotl64(s->v[2], 12) + rotl64(s->v[3], 18);
+        for (int i = 0; i < 4; i++) h = xxh_merge(h, s->v[i]);
+    }
+    else {
+        h = XXH_P5;
+    }
+    h += s->total;
+
+    const unsigned char* p = s->mem;
+    size_t len = s->memsize;
+    for (; len >= 8; p += 8, len -= 8) h = rotl64(h ^ xxh_round(0, read_le64(p)), 27) * XXH_P1 + XXH_P4;
+    if (len >= 4) {
+        h = rotl64(h ^ (uint64_t)read_le32(p) * XXH_P1, 23) * XXH_P2 + XXH_P3;
+        p += 4;
+        len -= 4;
+    }
+    for (; len > 0; p++, len--) h = rotl64(h ^ *p * XXH_P5, 11) * XXH_P1;
+
+    h ^= h >> 33;
+    h *= XXH_P2;
+    h ^= h >> 29;
+    h *= XXH_P3;
+    h ^= h >> 32;
+    return h;
+}
+
+//   --verify:   ,      
+struct hasher {
+    enum verify_mode mode;
+    uint32_t crc;
+    struct xxh64 xx;
+};
+
+static void hash_init(struct hasher* h, enum verify_mode mode) {
+    h->mode = mode;
+    h->crc = 0;
+    xxh64_init(&h->xx);
+}
+
+static void hash_update(struct hasher* h, const void* p, size_t len) {
+    if (h->mode == VERIFY_CRC32C) h->crc = crc32c(h->crc, p, len);
+    else xxh64_update(&h->xx, p, len);
+}
+
+static uint64_t hash_final(const struct hasher* h) {
+    return h->mode == VERIFY_CRC32C ? h->crc : xxh64_digest(&h->xx);
+}
+
+//   SRC        
+static void hash_zeros(struct hasher* h, off_t len) {
+    static const char zeros[BUF_SIZE];
+    while (len > 0) {
+        size_t n = len > BUF_SIZE ? BUF_SIZE : (size_t)len;
+        hash_update(h, zeros, n);
+        len -= (off_t)n;
+    }
+}
+
+//   . 1    EOF, 0    
+//     (errno ), -1  .
+static int copy_kernel(int in_fd, int out_fd, enum copy_engine e, struct copy_result* res) {
+    int started = 0;
+    for (;;) {
+        ssize_t n = (e == ENGINE_CFR)
+            ? copy_file_range(in_fd, NULL, out_fd, NULL, kernel_chunk(), 0)
+            : sendfile(out_fd, in_fd, NULL, kernel_chunk());
+        if (n > 0) {
+            started = 1;
+            res->written += n;
+            drop_behind(in_fd, out_fd, res->written, res);
+            continue;
+        }
+        if (n == 0) {
+            //  -  0 ,   
+            if (!started) { errno = EINVAL; return 0; }
+            return 1;
+        }
+        if (errno == EINTR) continue;
+        if (!started && engine_unsupported(errno)) return 0;
+        perror(engine_names[e]);
+        return -1;
+    }
+}
+
+//      user-space     fd
+static int copy_rw(int in_fd, int out_fd, struct copy_result* res) {
+    char buf[BUF_SIZE];
+    ssize_t n;
+    for (;;) {
+        n = read(in_fd, buf, sizeof buf);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        if (res->hash) hash_update(res->hash, buf, (size_t)n);
+        ssize_t off = 0;
+        while (off < n) {
+            ssize_t w = write(out_fd, buf + off, n - off);
+            if (w < 0 && errno == EINTR) continue;
+            if (w < 0) { perror("write"); return -1; }
+            off += w;
+        }
+        res->written += n;
+        drop_behind(in_fd, out_fd, res->written, res);
+    }
+    if (n < 0) { perror("read"); return -1; }
+    return 0;
+}
+
+// ---- --sparse:     ----
+
+static int is_zero(const char* p, size_t len) {
+    return len == 0 || (p[0] == 0 && memcmp(p, p + 1, len - 1) == 0);
+}
+
+static int pwrite_all(int fd, const char* p, size_t len, off_t off) {
+    while (len > 0) {
+        ssize_t w = pwrite(fd, p, len, off);
+        if (w < 0 && errno == EINTR) continue;
+        if (w < 0) { perror("write"); return -1; }
+        p += w;
+        off += w;
+        len -= (size_t)w;
+    }
+    return 0;
+}
+
+//   DEST  [off, off+len).     (fresh)   
+//    ,    ftruncate.
+static int make_hole(int out_fd, off_t off, off_t len, int fresh) {
+    if (fresh || len == 0) return 0;
+    if (fallocate(out_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, off, len) == 0) return 0;
+    if (errno != EOPNOTSUPP && errno != ENOSYS) { perror("fallocate"); return -1; }
+    //        
+    static const char zeros[BUF_SIZE];
+    while (len > 0) {
+        size_t n = len > BUF_SIZE ? BUF_SIZE : (size_t)len;
+        if (pwrite_all(out_fd, zeros, n, off) != 0) return -1;
+        off += (off_t)n;
+        len -= (off_t)n;
+    }
+    return 0;
+}
+
+//    [off, off+len).  --sparse=always   
+//   ,   ;   copy_file_range  .
+static int copy_extent(int in_fd, int out_fd, off_t off, off_t len, int fresh, struct copy_result* res) {
+    // --verify:     ,   
+    if (opt_sparse != SPARSE_ALWAYS && !res->hash && (opt_engine == ENGINE_AUTO || opt_engine == ENGINE_CFR)) {
+        off_t out_off = off;
+        while (len > 0) {
+            size_t want = (size_t)len > kernel_chunk() ? kernel_chunk() : (size_t)len;
+            ssize_t n = copy_file_range(in_fd, &off, out_fd, &out_off, want, 0);
+            if (n > 0) {
+                len -= n;
+                res->written += n;
+                drop_behind(in_fd, out_fd, off, res);
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            if (n == 0 || (opt_engine == ENGINE_AUTO && engine_unsupported(errno))) break;
+            perror("copy_file_range");
+            return -1;
+        }
+        if (len == 0) return 0;
+    }
+
+    char buf[BUF_SIZE];
+    while (len > 0) {
+        ssize_t n = pread(in_fd, buf, len > BUF_SIZE ? BUF_SIZE : (size_t)len, off);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) { perror("read"); return -1; }
+        if (n == 0) break;  //    
+        if (res->hash) hash_update(res->hash, buf, (size_t)n);
+
+        //     :     pwrite  
+        ssize_t b = 0;
+        while (b < n) {
+            size_t bl = (size_t)(n - b) < SPARSE_BLOCK ? (size_t)(n - b) : SPARSE_BLOCK;
+            int zero = opt_sparse == SPARSE_ALWAYS && is_zero(buf + b, bl);
+            ssize_t e = b + (ssize_t)bl;
+            while (e < n) {
+                size_t el = (size_t)(n - e) < SPARSE_BLOCK ? (size_t)(n - e) : SPARSE_BLOCK;
+                if ((opt_sparse == SPARSE_ALWAYS && is_zero(buf + e, el)) != zero) break;
+                e += (ssize_t)el;
+            }
+            if (zero) {
+                if (make_hole(out_fd, off + b, e - b, fresh) != 0) return -1;
+            }
+            else {
+                if (pwrite_all(out_fd, buf + b, (size_t)(e - b), off + b) != 0) return -1;
+                res->written += e - b;
+            }
+            b = e;
+        }
+        off += n;
+        len -= n;
+        drop_behind(in_fd, out_fd, off, res);
+    }
+    return 0;
+}
+
+//  SRC  SEEK_DATA/SEEK_HOLE. 1    (DEST   ).
+static int copy_sparse(int in_fd, int out_fd, const struct stat* st, int fresh, struct copy_result* res) {
+    struct stat st_out;
+    if (fstat(out_fd, &st_out) != 0 || !S_ISREG(st_out.st_mode)) return 1;
+
+    off_t end = st->st_size, pos = 0;
+    while (pos < end) {
+        off_t data = lseek(in_fd, pos, SEEK_DATA);
+        if (data < 0 && errno == ENXIO) data = end;  //     
+        else if (data < 0) data = pos;               //    SEEK_DATA   
+        if (make_hole(out_fd, pos, data - pos, fresh) != 0) return -1;
+        if (res->hash) hash_zeros(res->hash, data - pos);
+        if (data >= end) break;
+
+        off_t hole = lseek(in_fd, data, SEEK_HOLE);
+        if (hole < 0 || hole > end) hole = end;
+        if (copy_extent(in_fd, out_fd, data, hole - data, fresh, res) != 0) return -1;
+        pos = hole;
+    }
+    if (ftruncate(out_fd, end) != 0) { perror("ftruncate"); return -1; }
+    res->sparse = 1;
+    return 0;
+}
+
+//  SRC ( ,  )  --sparse=always:  
+static int want_sparse(const struct stat* st) {
+    return S_ISREG(st->st_mode) && st->st_size > 0 && opt_sparse != SPARSE_NEVER &&
+           (opt_sparse == SPARSE_ALWAYS || (off_t)st->st_blocks * 512 < st->st_size);
+}
+
+//    : SRC  , DEST  
+//           .
+//       ,     .
+static int prepare_io(int in_fd, int out_fd, const struct stat* st_src) {
+    if (!S_ISREG(st_src->st_mode) || st_src->st_size == 0) return 0;
+    (void)posix_fadvise(in_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    struct stat st_out;
+    //    preallocate   
+    if (!opt_prealloc || want_sparse(st_src) || fstat(out_fd, &st_out) != 0 || !S_ISREG(st_out.st_mode))
+        return 0;
+    if (fallocate(out_fd, FALLOC_FL_KEEP_SIZE, 0, st_src->st_size) != 0 && errno == ENOSPC) {
+        perror("fallocate");
+        return -1;
+    }
+    return 0;
+}
+
+//     : copy_file_range -> sendfile -> read/write.
+//   fd  ,    
+//    .   --engine   .
+static int copy_data(int in_fd, int out_fd, const struct stat* st_src, struct copy_result* res) {
+    if (want_sparse(st_src)) {
+        int r = copy_sparse(in_fd, out_fd, st_src, 1, res);
+        if (r <= 0) return r;
+    }
+
+    if (opt_engine == ENGINE_RW || res->hash) return copy_rw(in_fd, out_fd, res);
+
+    if (opt_engine != ENGINE_AUTO) {
+        // st_size == 0   EOF:  /proc  sysfs  ,   .
+        //       ,   auto,  read/write.
+        if (S_ISREG(st_src->st_mode) && st_src->st_size == 0) return copy_rw(in_fd, out_fd, res);
+        int r = copy_kernel(in_fd, out_fd, opt_engine, res);
+        if (r == 0) perror(engine_names[opt_engine]);
+        return r > 0 ? 0 : -1;
+    }
+
+    //         
+    if (S_ISREG(st_src->st_mode) && st_src->st_size > 0) {
+        int r = copy_kernel(in_fd, out_fd, ENGINE_CFR, res);
+        if (r == 0) r = copy_kernel(in_fd, out_fd, ENGINE_SENDFILE, res);
+        if (r != 0) return r > 0 ? 0 : -1;
+    }
+    return copy_rw(in_fd, out_fd, res);
+}
+
+// ---- --direct: O_DIRECT +   / ----
+//
+//   DIRECT_SLOTS  .     :
+//   N ->   N ->    .
+//    N,   N+1, N+2, ...    .
+
+struct ring {
+    int uring;                  // 1  io_uring, 0  POSIX AIO
+    struct aiocb cb[DIRECT_SLOTS];
+    int busy[DIRECT_SLOTS];
+#ifdef HAVE_IO_URING
+    int fd;
+    unsigned pending;           //   SQ,     
+    unsigned *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe* sqes;
+    struct io_uring_cqe* cqes;
+    void* sq_map;
+    void* cq_map;
+    size_t sq_map_sz, cq_map_sz, sqes_sz;
+    struct iovec iov[DIRECT_SLOTS];
+#endif
+};
+
+#ifdef HAVE_IO_URING
+static int uring_init(struct ring* r) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof p);
+    r->fd = (int)syscall(__NR_io_uring_setup, DIRECT_SLOTS, &p);
+    if (r->fd < 0) return -1;
+
+    r->sq_map_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_map_sz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (r->cq_map_sz > r->sq_map_sz) r->sq_map_sz = r->cq_map_sz;
+        r->cq_map_sz = r->sq_map_sz;
+    }
+    r->sq_map = mmap(NULL, r->sq_map_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     r->fd, IORING_OFF_SQ_RING);
+    if (r->sq_map == MAP_FAILED) { close(r->fd); return -1; }
+    r->cq_map = r->sq_map;
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP)) {
+        r->cq_map = mmap(NULL, r->cq_map_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         r->fd, IORING_OFF_CQ_RING);
+        if (r->cq_map == MAP_FAILED) { munmap(r->sq_map, r->sq_map_sz); close(r->fd); return -1; }
+    }
+    r->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = mmap(NULL, r->sqes_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   r->fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) {
+        if (r->cq_map != r->sq_map) munmap(r->cq_map, r->cq_map_sz);
+        munmap(r->sq_map, r->sq_map_sz);
+        close(r->fd);
+        return -1;
+    }
+
+    char* sq = r->sq_map;
+    char* cq = r->cq_map;
+    r->sq_tail = (unsigned*)(sq + p.sq_off.tail);
+    r->sq_mask = (unsigned*)(sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned*)(sq + p.sq_off.array);
+    r->cq_head = (unsigned*)(cq + p.cq_off.head);
+    r->cq_tail = (unsigned*)(cq + p.cq_off.tail);
+    r->cq_mask = (unsigned*)(cq + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+    r->pending = 0;
+    return 0;
+}
+
+static int uring_enter(struct ring* r, unsigned min_complete) {
+    for (;;) {
+        long n = syscall(__NR_io_uring_enter, r->fd, r->pending, min_complete,
+                         min_complete ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        if (n >= 0) { r->pending -= (unsigned)n; return 0; }
+        if (errno != EINTR) return -1;
+    }
+}
+#endif
+
+static int ring_init(struct ring* r, enum direct_mode mode) {
+    memset(r, 0, sizeof *r);
+#ifdef HAVE_IO_URING
+    if (mode != DIRECT_AIO && uring_init(r) == 0) { r->uring = 1; return 0; }
+    if (mode == DIRECT_URING) { perror("io_uring_setup"); return -1; }
+#else
+    if (mode == DIRECT_URING) { fprintf(stderr, "cp: built without io_uring\n"); return -1; }
+#endif
+    return 0;  // POSIX AIO   
+}
+
+static void ring_destroy(struct ring* r) {
+#ifdef HAVE_IO_URING
+    if (r->uring) {
+        munmap(r->sqes, r->sqes_sz);
+        if (r->cq_map != r->sq_map) munmap(r->cq_map, r->cq_map_sz);
+        munmap(r->sq_map, r->sq_map_sz);
+        close(r->fd);
+        return;
+    }
+#endif
+    //  AIO ( )     
+    for (int i = 0; i < DIRECT_SLOTS; i++) {
+        if (!r->busy[i]) continue;
+        aio_cancel(r->cb[i].aio_fildes, &r->cb[i]);
+        const struct aiocb* one[1] = { &r->cb[i] };
+        while (aio_error(&r->cb[i]) == EINPROGRESS) aio_suspend(one, 1, NULL);
+        (void)aio_return(&r->cb[i]);
+    }
+}
+
+static int ring_submit(struct ring* r, int slot, int is_write, int fd, char* buf, size_t len, off_t off) {
+#ifdef HAVE_IO_URING
+    if (r->uring) {
+        unsigned tail = *r->sq_tail;
+        unsigned idx = tail & *r->sq_mask;
+        struct io_uring_sqe* sqe = &r->sqes[idx];
+        r->iov[slot].iov_base = buf;
+        r->iov[slot].iov_len = len;
+        memset(sqe, 0, sizeof *sqe);
+        sqe->opcode = is_write ? IORING_OP_WRITEV : IORING_OP_READV;
+        sqe->fd = fd;
+        sqe->addr = (unsigned long long)(uintptr_t)&r->iov[slot];
+        sqe->len = 1;
+        sqe->off = (unsigned long long)off;
+        sqe->user_data = (unsigned long long)slot;
+        r->sq_array[idx] = idx;
+        __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+        r->pending++;
+        return 0;  //      ring_wait
+    }
+#endif
+    struct aiocb* cb = &r->cb[slot];
+    memset(cb, 0, sizeof *cb);
+    cb->aio_fildes = fd;
+    cb->aio_buf = buf;
+    cb->aio_nbytes = len;
+    cb->aio_offset = off;
+    if ((is_write ? aio_write(cb) : aio_read(cb)) != 0) return -1;
+    r->busy[slot] = 1;
+    return 0;
+}
+
+//    . *res    -errno.
+static int ring_wait(struct ring* r, int* slot, long* res) {
+#ifdef HAVE_IO_URING
+    if (r->uring) {
+        for (;;) {
+            unsigned head = *r->cq_head;
+            int ready = head != __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+            if (r->pending || !ready) {
+                if (uring_enter(r, ready ? 0 : 1) != 0) return -1;
+                if (!ready) continue;
+            }
+            struct io_uring_cqe* cqe = &r->cqes[head & *r->cq_mask];
+            *slot = (int)cqe->user_data;
+            *res = cqe->res;
+            __atomic_store_n(r->cq_head, head + 1, __ATOMIC_RELEASE);
+            return 0;
+        }
+    }
+#endif
+    for (;;) {
+        const struct aiocb* list[DIRECT_SLOTS];
+        int n = 0;
+        for (int i = 0; i < DIRECT_SLOTS; i++) {
+            if (!r->busy[i]) continue;
+            int e = aio_error(&r->cb[i]);
+            if (e != EINPROGRESS) {
+                ssize_t v = aio_return(&r->cb[i]);
+                r->busy[i] = 0;
+                *slot = i;
+                *res = e ? -e : (long)v;
+                return 0;
+            }
+            list[n++] = &r->cb[i];
+        }
+        if (n == 0) { errno = EINVAL; return -1; }
+        if (aio_suspend(list, n, NULL) != 0 && errno != EINTR && errno != EAGAIN) return -1;
+    }
+}
+
+struct dslot {
+    char* buf;
+    off_t off;
+    size_t len;   //     
+    int writing;
+};
+
+static long long direct_bytes = 0;  //     (  -j)
+
+// 1    (  ), 0  , -1  
+static int copy_direct(int in_fd, int out_fd, const struct stat* st, struct copy_result* res) {
+    struct stat st_out;
+    if (!S_ISREG(st->st_mode) || st->st_size == 0 ||
+        fstat(out_fd, &st_out) != 0 || !S_ISREG(st_out.st_mode)) return 1;
+
+    // O_DIRECT      fd; tmpfs  .    
+    //    page cache,     
+    int in_direct = fcntl(in_fd, F_SETFL, fcntl(in_fd, F_GETFL) | O_DIRECT) == 0;
+    int out_direct = fcntl(out_fd, F_SETFL, fcntl(out_fd, F_GETFL) | O_DIRECT) == 0;
+
+    struct ring r;
+    if (ring_init(&r, opt_direct) != 0) return -1;
+
+    struct dslot slots[DIRECT_SLOTS];
+    memset(slots, 0, sizeof slots);
+    int rc = 0, inflight = 0;
+    off_t size = st->st_size, next = 0;
+    double t0 = now_sec();
+
+    for (int i = 0; i < DIRECT_SLOTS && rc == 0; i++) {
+        if (posix_memalign((void**)&slots[i].buf, DIRECT_ALIGN, DIRECT_CHUNK) != 0) {
+            slots[i].buf = NULL;
+            fprintf(stderr, "cp: out of memory for direct buffers\n");
+            rc = -1;
+        }
+    }
+
+    // :      
+    for (int i = 0; i < DIRECT_SLOTS && rc == 0 && next < size; i++) {
+        size_t want = in_direct ? DIRECT_CHUNK
+                                : (size_t)(size - next < DIRECT_CHUNK ? size - next : DIRECT_CHUNK);
+        slots[i].off = next;
+        slots[i].writing = 0;
+        if (ring_submit(&r, i, 0, in_fd, slots[i].buf, want, next) != 0) { perror("aio_read"); rc = -1; break; }
+        next += DIRECT_CHUNK;
+        inflight++;
+    }
+
+    while (inflight > 0) {
+        int i;
+        long n;
+        if (ring_wait(&r, &i, &n) != 0) { perror("io wait"); rc = -1; break; }
+        inflight--;
+        struct dslot* sl = &slots[i];
+        if (rc != 0) continue;  //     
+        if (n < 0) {
+            errno = (int)-n;
+            perror(sl->writing ? "write" : "read");
+            rc = -1;
+            continue;
+        }
+
+        if (!sl->writing) {
+            off_t want = size - sl->off < DIRECT_CHUNK ? size - sl->off : DIRECT_CHUNK;
+            if (n != want) {
+                fprintf(stderr, "cp: short read at offset %lld (file changed?)\n", (long long)sl->off);
+                rc = -1;
+                continue;
+            }
+            // O_DIRECT    :   ,   ftruncate
+            sl->len = (size_t)n;
+            size_t wlen = sl->len;
+            if (out_direct && wlen % DIRECT_ALIGN) {
+                size_t pad = DIRECT_ALIGN - wlen % DIRECT_ALIGN;
+                memset(sl->buf + wlen, 0, pad);
+                wlen += pad;
+            }
+            sl->writing = 1;
+            if (ring_submit(&r, i, 1, out_fd, sl->buf, wlen, sl->off) != 0) { perror("aio_write"); rc = -1; continue; }
+            inflight++;
+            continue;
+        }
+
+        if ((size_t)n < sl->len) {
+            fprintf(stderr, "cp: short write at offset %lld\n", (long long)sl->off);
+            rc = -1;
+            continue;
+        }
+        res->written += (long long)sl->len;
+        //        
+        if (next < size) {
+            size_t want = in_direct ? DIRECT_CHUNK
+                                    : (size_t)(size - next < DIRECT_CHUNK ? size - next : DIRECT_CHUNK);
+            sl->off = next;
+            sl->writing = 0;
+            if (ring_submit(&r, i, 0, in_fd, sl->buf, want, next) != 0) { perror("aio_read"); rc = -1; continue; }
+            next += DIRECT_CHUNK;
+            inflight++;
+        }
+    }
+
+    ring_destroy(&r);
+    for (int i = 0; i < DIRECT_SLOTS; i++) free(slots[i].buf);
+
+    if (rc == 0 && out_direct && ftruncate(out_fd, size) != 0) { perror("ftruncate"); rc = -1; }
+    if (rc != 0) return -1;
+
+    double dt = now_sec() - t0;
+    res->direct = r.uring ? "io_uring" : "posix aio";
+    res->mbps = dt > 0 ? (double)size / dt / 1e6 : 0;
+    __atomic_fetch_add(&direct_bytes, (long long)size, __ATOMIC_RELAXED);
+    return 0;
+}
+
+//   :   +   .
+// dir        (NULL,  name    ).
+struct loc {
+    int dirfd;
+    const char* dir;
+    const char* name;
+};
+
+//            *at()
+static const char* loc_path(const struct loc* l, char* buf, size_t cap) {
+    if (!l->dir) return l->name;
+    join_path(buf, cap, l->dir, l->name);
+    return buf;
+}
+
+// ---- --resume:      DEST ----
+//
+// DEST    RESUME_BLOCK.     fdatasync(DEST),
+//      DEST.mycp-journal    end   .
+//         ;  
+//   .
+
+//  :   ,  SRC  ,     
+struct jheader {
+    char magic[8];
+    uint32_t block;
+    uint32_t with_crc;   //    CRC32C 
+    uint64_t size;
+    uint64_t ino;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+};
+
+// ,   end,   . self  CRC32C  :
+//         .
+struct jrecord {
+    uint64_t end;
+    uint32_t crc;
+    uint32_t self;
+};
+
+struct journal {
+    int fd;
+    char name[PATH_MAX];   //  dst->dirfd
+    struct jrecord* rec;
+    size_t n, cap;
+};
+
+static const char JOURNAL_MAGIC[8] = { 'M', 'Y', 'C', 'P', 'J', 'N', 'L', '1' };
+
+static uint32_t jrecord_self(const struct jrecord* r) {
+    return crc32c(0, r, offsetof(struct jrecord, self));
+}
+
+static void jheader_fill(struct jheader* h, const struct stat* st) {
+    memset(h, 0, sizeof *h);
+    memcpy(h->magic, JOURNAL_MAGIC, sizeof h->magic);
+    h->block = (uint32_t)RESUME_BLOCK;
+    h->with_crc = opt_resume == RESUME_CRC;
+    h->size = (uint64_t)st->st_size;
+    h->ino = (uint64_t)st->st_ino;
+    h->mtime_sec = (int64_t)st->st_mtim.tv_sec;
+    h->mtime_nsec = (int64_t)st->st_mtim.tv_nsec;
+}
+
+static int journal_push(struct journal* jn, const struct jrecord* r) {
+    if (jn->n == jn->cap) {
+        size_t cap = jn->cap ? jn->cap * 2 : 64;
+        struct jrecord* v = realloc(jn->rec, cap * sizeof *v);
+        if (!v) { perror("realloc"); return -1; }
+        jn->rec = v;
+        jn->cap = cap;
+    }
+    jn->rec[jn->n++] = *r;
+    return 0;
+}
+
+//  [from, end)  DEST   ,    ?
+static int block_intact(int out_fd, off_t from, off_t end, uint32_t want) {
+    char buf[BUF_SIZE];
+    uint32_t crc = 0;
+    while (from < end) {
+        ssize_t n = pread(out_fd, buf, end - from < BUF_SIZE ? (size_t)(end - from) : BUF_SIZE, from);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 0;
+        crc = crc32c(crc, buf, (size_t)n);
+        from += n;
+    }
+    return crc == want;
+}
+
+//  ( )   ,    .
+//    SRC       .
+static int journal_open(struct journal* jn, const struct loc* dst, int out_fd,
+                        const struct stat* st, off_t* done) {
+    char dbuf[PATH_MAX];
+    memset(jn, 0, sizeof *jn);
+    jn->fd = -1;  //    openat: journal_close    fd 0
+    *done = 0;
+    if ((size_t)snprintf(jn->name, sizeof jn->name, "%s%s", dst->name, JOURNAL_SUFFIX) >= sizeof jn->name) {
+        errno = ENAMETOOLONG;
+        perror(loc_path(dst, dbuf, sizeof dbuf));
+        return -1;
+    }
+    jn->fd = openat(dst->dirfd, jn->name, O_RDWR | O_CREAT, 0666);
+    if (jn->fd < 0) { perror(jn->name); return -1; }
+
+    struct jheader want, have;
+    jheader_fill(&want, st);
+    int valid = pread(jn->fd, &have, sizeof have, 0) == (ssize_t)sizeof have &&
+                memcmp(&have, &want, sizeof have) == 0;
+
+    if (valid) {
+        struct jrecord r;
+        off_t at = sizeof have;
+        uint64_t prev = 0;
+        while (pread(jn->fd, &r, sizeof r, at) == (ssize_t)sizeof r && r.self == jrecord_self(&r) &&
+               r.end > prev && r.end <= (uint64_t)st->st_size) {
+            if (journal_push(jn, &r) != 0) return -1;
+            prev = r.end;
+            at += sizeof r;
+        }
+
+        // DEST ,    ( )   
+        struct stat st_out;
+        if (fstat(out_fd, &st_out) != 0) { perror(loc_path(dst, dbuf, sizeof dbuf)); return -1; }
+        while (jn->n > 0 && jn->rec[jn->n - 1].end > (uint64_t)st_out.st_size) jn->n--;
+
+        //      :  
+        //   ,      
+        if (opt_resume == RESUME_CRC) {
+            while (jn->n > 0) {
+                off_t from = jn->n > 1 ? (off_t)jn->rec[jn->n - 2].end : 0;
+                const struct jrecord* last = &jn->rec[jn->n - 1];
+                if (block_intact(out_fd, from, (off_t)last->end, last->crc)) break;
+                jn->n--;
+            }
+        }
+        if (ftruncate(jn->fd, (off_t)(sizeof have + jn->n * sizeof(struct jrecord))) != 0) {
+            perror(jn->name);
+            return -1;
+        }
+        *done = jn->n ? (off_t)jn->rec[jn->n - 1].end : 0;
+        return 0;
+    }
+
+    //  : DEST  ,    
+    if (ftruncate(out_fd, 0) != 0) { perror(loc_path(dst, dbuf, sizeof dbuf)); return -1; }
+    if (ftruncate(jn->fd, 0) != 0 || pwrite(jn->fd, &want, sizeof want, 0) != (ssize_t)sizeof want ||
+        fdatasync(jn->fd) != 0) {
+        perror(jn->name);
+        return -1;
+    }
+    return 0;
+}
+
+static int journal_commit(struct journal* jn, off_t end, uint32_t crc) {
+    struct jrecord r = { (uint64_t)end, crc, 0 };
+    r.self = jrecord_self(&r);
+    off_t at = (off_t)(sizeof(struct jheader) + jn->n * sizeof r);
+    if (pwrite(jn->fd, &r, sizeof r, at) != (ssize_t)sizeof r || fdatasync(jn->fd) != 0) {
+        perror(jn->name);
+        return -1;
+    }
+    return journal_push(jn, &r);
+}
+
+// ok        ;     
+static void journal_close(struct journal* jn, const struct loc* dst, int ok) {
+    if (jn->fd >= 0) close(jn->fd);
+    if (ok) (void)unlinkat(dst->dirfd, jn->name, 0);
+    free(jn->rec);
+    jn->fd = -1;
+    jn->rec = NULL;
+}
+
+static int copy_resume(int in_fd, int out_fd, const struct stat* st, struct journal* jn,
+                       off_t off, struct copy_result* res) {
+    off_t size = st->st_size;
+    res->resumed = off;
+    while (off < size) {
+        off_t end = size - off > RESUME_BLOCK ? off + RESUME_BLOCK : size;
+        uint32_t crc = 0;
+        if (opt_resume == RESUME_CRC) {
+            char buf[BUF_SIZE];
+            for (off_t p = off; p < end;) {
+                ssize_t n = pread(in_fd, buf, end - p < BUF_SIZE ? (size_t)(end - p) : BUF_SIZE, p);
+                if (n < 0 && errno == EINTR) continue;
+                if (n < 0) { perror("read"); return -1; }
+                if (n == 0) { fprintf(stderr, "cp: source shrank during copy\n"); return -1; }
+                crc = crc32c(crc, buf, (size_t)n);
+                if (pwrite_all(out_fd, buf, (size_t)n, p) != 0) return -1;
+                res->written += n;
+                p += n;
+            }
+        }
+        else if (copy_extent(in_fd, out_fd, off, end - off, 0, res) != 0) {
+            return -1;
+        }
+        //    ,        
+        if (fdatasync(out_fd) != 0) { perror("fdatasync"); return -1; }
+        if (journal_commit(jn, end, crc) != 0) return -1;
+        off = end;
+    }
+    if (ftruncate(out_fd, size) != 0) { perror("ftruncate"); return -1; }
+    return 0;
+}
+
+// ---- --verify:  DEST  ,    ----
+//
+// SRC      ,      .
+// DEST :    page cache (   
+//     ),  ",direct"   fdatasync  ,  .
+
+static int verify_dest(int out_fd, const struct loc* dst, struct copy_result* res) {
+    char dbuf[PATH_MAX];
+    struct stat st;
+    if (fstat(out_fd, &st) != 0 || !S_ISREG(st.st_mode)) return 0;  //  /   
+    if (opt_verify_direct && fdatasync(out_fd) != 0) { perror("fdatasync"); return -1; }
+
+    int fd = -1;
+    if (opt_verify_direct) fd = openat(dst->dirfd, dst->name, O_RDONLY | O_DIRECT);
+    int direct = fd >= 0;
+    if (fd < 0) fd = openat(dst->dirfd, dst->name, O_RDONLY);  //   O_DIRECT    
+    if (fd < 0) { perror(loc_path(dst, dbuf, sizeof dbuf)); return -1; }
+
+    // O_DIRECT   ;     
+    void* mem;
+    if (posix_memalign(&mem, DIRECT_ALIGN, DIRECT_CHUNK) != 0) {
+        fprintf(stderr, "cp: out of memory\n");
+        close(fd);
+        return -1;
+    }
+    char* buf = mem;
+    if (!direct) (void)posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    struct hasher h;
+    hash_init(&h, opt_verify);
+    int rc = 0;
+    for (;;) {
+        ssize_t n = read(fd, buf, DIRECT_CHUNK);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) { perror(loc_path(dst, dbuf, sizeof dbuf)); rc = -1; break; }
+        if (n == 0) break;
+        hash_update(&h, buf, (size_t)n);
+    }
+    free(mem);
+    close(fd);
+    if (rc != 0) return -1;
+
+    uint64_t want = hash_final(res->hash), got = hash_final(&h);
+    if (want != got) {
+        fprintf(stderr, "cp: verification failed for '%s': %s %016llx, expected %016llx\n",
+                loc_path(dst, dbuf, sizeof dbuf), verify_names[opt_verify],
+                (unsigned long long)got, (unsigned long long)want);
+        return -1;
+    }
+    res->verified = 1;
+    res->digest = got;
+    return 0;
+}
+
+// ---- -p:  SRC -> DEST ----
+//
+//       DEST (fchown/fchmod/futimens/fsetxattr),
+//    .      
+// :  root    ,     xattr, 
+//  (trusted.*, security.*)  .    ,     .
+
+#define OWN_CACHE 64       //  uid:gid   
+#define XATTR_DEVS 8       //     xattr
+#define XATTR_DENIED 16    //  xattr,    
+
+enum own_state { OWN_UNKNOWN, OWN_FULL, OWN_GROUP, OWN_NONE };
+
+static struct {
+    pthread_mutex_t mu;
+    struct { uid_t uid; gid_t gid; enum own_state state; } own[OWN_CACHE];
+    dev_t no_xattr_dev[XATTR_DEVS];
+    int n_no_xattr_dev;
+    int dst_no_xattr;  //  DEST xattr     -r/-j     
+    char* denied[XATTR_DENIED];
+    int n_denied;
+} pcache = { .mu = PTHREAD_MUTEX_INITIALIZER };
+
+static size_t own_slot(uid_t uid, gid_t gid) {
+    return ((size_t)uid * 31 + (size_t)gid) % OWN_CACHE;
+}
+
+static enum own_state own_lookup(uid_t uid, gid_t gid) {
+    pthread_mutex_lock(&pcache.mu);
+    size_t i = own_slot(uid, gid);
+    enum own_state s = (pcache.own[i].uid == uid && pcache.own[i].gid == gid) ? pcache.own[i].state : OWN_UNKNOWN;
+    pthread_mutex_unlock(&pcache.mu);
+    return s;
+}
+
+static void own_store(uid_t uid, gid_t gid, enum own_state s) {
+    pthread_mutex_lock(&pcache.mu);
+    size_t i = own_slot(uid, gid);
+    pcache.own[i].uid = uid;
+    pcache.own[i].gid = gid;
+    pcache.own[i].state = s;
+    pthread_mutex_unlock(&pcache.mu);
+}
+
+// chown  fd ,    ,  fchownat  
+static int chown_node(int fd, const struct loc* dst, uid_t uid, gid_t gid) {
+    return fd >= 0 ? fchown(fd, uid, gid) : fchownat(dst->dirfd, dst->name, uid, gid, AT_SYMLINK_NOFOLLOW);
+}
+
+// :  uid  gid,      ( GNU cp  root).
+//     .  *kept    S_ISUID/S_ISGID  .
+static int preserve_owner(int fd, const struct loc* dst, const struct stat* st, mode_t* kept) {
+    char buf[PATH_MAX];
+    enum own_state s = own_lookup(st->st_uid, st->st_gid);
+    if (s == OWN_UNKNOWN || s == OWN_FULL) {
+        if (chown_node(fd, dst, st->st_uid, st->st_gid) == 0) s = OWN_FULL;
+        else if (errno == EPERM || errno == EINVAL) s = OWN_GROUP;
+        else goto fail;
+    }
+    if (s == OWN_GROUP && chown_node(fd, dst, (uid_t)-1, st->st_gid) != 0) {
+        if (errno != EPERM && errno != EINVAL) goto fail;
+        s = OWN_NONE;
+    }
+    own_store(st->st_uid, st->st_gid, s);
+    *kept = s == OWN_FULL ? S_ISUID | S_ISGID : s == OWN_GROUP ? S_ISGID : 0;
+    return 0;
+fail:
+    fprintf(stderr, "cp: failed to preserve ownership for '%s': %s\n",
+            loc_path(dst, buf, sizeof buf), strerror(errno));
+    return -1;
+}
+
+static int xattr_src_skipped(dev_t dev) {
+    int skip = 0;
+    pthread_mutex_lock(&pcache.mu);
+    for (int i = 0; i < pcache.n_no_xattr_dev && !skip; i++) skip = pcache.no_xattr_dev[i] == dev;
+    skip = skip || pcache.dst_no_xattr;
+    pthread_mutex_unlock(&pcache.mu);
+    return skip;
+}
+
+static int xattr_denied(const char* name) {
+    int hit = 0;
+    pthread_mutex_lock(&pcache.mu);
+    for (int i = 0; i < pcache.n_denied && !hit; i++) hit = strcmp(pcache.denied[i], name) == 0;
+    pthread_mutex_unlock(&pcache.mu);
+    return hit;
+}
+
+static void xattr_remember(dev_t src_dev, int dst_off, const char* denied) {
+    pthread_mutex_lock(&pcache.mu);
+    if (src_dev && pcache.n_no_xattr_dev < XATTR_DEVS) pcache.no_xattr_dev[pcache.n_no_xattr_dev++] = src_dev;
+    if (dst_off) pcache.dst_no_xattr = 1;
+    if (denied && pcache.n_denied < XATTR_DENIED) {
+        char* copy = strdup(denied);
+        if (copy) pcache.denied[pcache.n_denied++] = copy;
+    }
+    pthread_mutex_unlock(&pcache.mu);
+}
+
+//  .   xattr    flistxattr.
+static int preserve_xattrs(int src_fd, int fd, const struct loc* dst, const struct stat* st) {
+    char buf[PATH_MAX];
+    if (xattr_src_skipped(st->st_dev)) return 0;
+    ssize_t n = flistxattr(src_fd, NULL, 0);
+    if (n < 0 && (errno == ENOTSUP || errno == ENOSYS)) { xattr_remember(st->st_dev, 0, NULL); return 0; }
+    if (n <= 0) return n == 0 ? 0 : (perror("flistxattr"), -1);
+
+    char* names = malloc((size_t)n);
+    char* val = NULL;
+    size_t cap = 0;
+    int rc = 0;
+    if (!names || (n = flistxattr(src_fd, names, (size_t)n)) < 0) { perror("flistxattr"); free(names); return -1; }
+    for (char* name = names; name < names + n && rc == 0; name += strlen(name) + 1) {
+        if (xattr_denied(name)) continue;
+        ssize_t vn = fgetxattr(src_fd, name, NULL, 0);
+        if (vn < 0) continue;  //   
+        if ((size_t)vn > cap) {
+            char* p = realloc(val, (size_t)vn);
+            if (!p) { perror("realloc"); rc = -1; break; }
+            val = p;
+            cap = (size_t)vn;
+        }
+        if ((vn = fgetxattr(src_fd, name, val, cap)) < 0) continue;
+        if (fsetxattr(fd, name, val, (size_t)vn, 0) == 0) continue;
+        if (errno == ENOTSUP) { xattr_remember(0, 1, NULL); break; }
+        if (errno == EPERM || errno == EACCES) { xattr_remember(0, 0, name); continue; }
+        fprintf(stderr, "cp: setting attribute '%s' for '%s': %s\n",
+                name, loc_path(dst, buf, sizeof buf), strerror(errno));
+        rc = -1;
+    }
+    free(val);
+    free(names);
+    return rc;
+}
+
+//  SRC -> DEST: , xattr, , . fd >= 0   
+// (src_fd   xattr); fd < 0  /FIFO/  *at()  .
+//   :     ,     GNU cp.
+static int preserve_meta(int src_fd, int fd, const struct loc* dst, const struct stat* st) {
+    char buf[PATH_MAX];
+    mode_t kept;
+    if (preserve_owner(fd, dst, st, &kept) != 0) return -1;
+    if (src_fd >= 0 && fd >= 0 && preserve_xattrs(src_fd, fd, dst, st) != 0) return -1;
+
+    //    setuid/setgid  
+    mode_t mode = st->st_mode & ((07777 & ~(S_ISUID | S_ISGID)) | kept);
+    if (!S_ISLNK(st->st_mode) &&
+        (fd >= 0 ? fchmod(fd, mode) : fchmodat(dst->dirfd, dst->name, mode, 0)) != 0) {
+        fprintf(stderr, "cp: preserving permissions for '%s': %s\n",
+                loc_path(dst, buf, sizeof buf), strerror(errno));
+        return -1;
+    }
+    struct timespec ts[2] = { st->st_atim, st->st_mtim };
+    if ((fd >= 0 ? futimens(fd, ts) : utimensat(dst->dirfd, dst->name, ts, AT_SYMLINK_NOFOLLOW)) != 0) {
+        fprintf(stderr, "cp: preserving times for '%s': %s\n",
+                loc_path(dst, buf, sizeof buf), strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+// hash   --verify (NULL   )
+static int copy_one(const struct loc* src, const struct loc* dst, struct copy_result* res, struct hasher* hash) {
+    char sbuf[PATH_MAX], dbuf[PATH_MAX];
+    memset(res, 0, sizeof *res);
+    res->status = -1;
+    if (hash) {
+        hash_init(hash, opt_verify);
+        res->hash = hash;
+    }
+    double ph[PH_COUNT] = { 0 }, t = 0;
+    lap(&t, NULL, PH_OPEN);
+
+    int in_fd = openat(src->dirfd, src->name, O_RDONLY);
+    if (in_fd < 0) { perror(loc_path(src, sbuf, sizeof sbuf)); return -1; }
+    lap(&t, ph, PH_OPEN);
 
     //     -r (   GNU cp)
     struct stat st_src;
-    if (fstat(in_fd, &st_src) == 0 && S_ISDIR(st_src.st_mode)) {
-        fprintf(stderr, "cp: -r not specified; omitting directory '%s'\n", src);
+    if (fstat(in_fd, &st_src) != 0) { perror(loc_path(src, sbuf, sizeof sbuf)); close(in_fd); return -1; }
+    if (S_ISDIR(st_src.st_mode)) {
+        fprintf(stderr, "cp: -r not specified; omitting directory '%s'\n", loc_path(src, sbuf, sizeof sbuf));
         close(in_fd);
         return -1;
     }
 
     // : SRC  DEST      ?
     struct stat st_dst;
-    if (stat(dst, &st_dst) == 0) {
+    int dst_exists = fstatat(dst->dirfd, dst->name, &st_dst, 0) == 0;
+    lap(&t, ph, PH_STAT);
+    if (dst_exists) {
         if (S_ISREG(st_src.st_mode) && S_ISREG(st_dst.st_mode) &&
             st_src.st_dev == st_dst.st_dev && st_src.st_ino == st_dst.st_ino) {
-            fprintf(stderr, "cp: '%s' and '%s' are the same file\n", src, dst);
+            fprintf(stderr, "cp: '%s' and '%s' are the same file\n",
+                    loc_path(src, sbuf, sizeof sbuf), loc_path(dst, dbuf, sizeof dbuf));
             close(in_fd);
             return -1;
         }
         //   -i   
-        if (opt_i && !confirm_overwrite(dst)) {
-            if (opt_v) fprintf(stdout, "skipped '%s'\n", dst);
+        if (opt_i && !confirm_overwrite(loc_path(dst, dbuf, sizeof dbuf))) {
+            res->skipped = 1;
+            res->status = 0;
             close(in_fd);
             return 0;
         }
+        lap(&t, NULL, PH_STAT);  //      
     }
 
-    int out_fd = open(dst, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    // --resume: DEST          
+    int resume = opt_resume != RESUME_OFF && S_ISREG(st_src.st_mode);
+    int oflags = resume ? O_RDWR | O_CREAT : O_WRONLY | O_CREAT | O_TRUNC;
+    int out_fd = openat(dst->dirfd, dst->name, oflags, 0666);
     if (out_fd < 0) {
         //       -f,     
         if (opt_f && errno != ENOENT) {
-            (void)unlink(dst);
-            out_fd = open(dst, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+            (void)unlinkat(dst->dirfd, dst->name, 0);
+            out_fd = openat(dst->dirfd, dst->name, oflags, 0666);
         }
-        if (out_fd < 0) { perror(dst); close(in_fd); return -1; }
+        if (out_fd < 0) { perror(loc_path(dst, dbuf, sizeof dbuf)); close(in_fd); return -1; }
     }
+    lap(&t, ph, PH_OPEN);
 
-    char buf[BUF_SIZE];
-    ssize_t n;
-    while ((n = read(in_fd, buf, sizeof buf)) > 0) {
-        ssize_t off = 0;
-        while (off < n) {
-            ssize_t w = write(out_fd, buf + off, n - off);
-            if (w < 0) { perror("write"); close(in_fd); close(out_fd); return -1; }
-            off += w;
+    struct journal jn = { -1, "", NULL, 0, 0 };
+    if (resume) {
+        off_t from;
+        if (journal_open(&jn, dst, out_fd, &st_src, &from) != 0 ||
+            copy_resume(in_fd, out_fd, &st_src, &jn, from, res) != 0) {
+            journal_close(&jn, dst, 0);
+            close(in_fd);
+            close(out_fd);
+            return -1;
         }
     }
-    if (n < 0) { perror("read"); close(in_fd); close(out_fd); return -1; }
 
-    if (close(out_fd) < 0) { perror("close"); close(in_fd); return -1; }
+    //  CoW- (btrfs, XFS) DEST      SRC  O(1)
+    int cloned = 0;
+    if (!resume && opt_reflink != REFLINK_NEVER && S_ISREG(st_src.st_mode)) {
+        cloned = ioctl(out_fd, FICLONE, in_fd) == 0;
+        if (!cloned && opt_reflink == REFLINK_ALWAYS) {
+            int e = errno;
+            fprintf(stderr, "cp: failed to clone '%s' from '%s': %s\n",
+                    loc_path(dst, dbuf, sizeof dbuf), loc_path(src, sbuf, sizeof sbuf), strerror(e));
+            close(in_fd);
+            close(out_fd);
+            (void)unlinkat(dst->dirfd, dst->name, 0);  //    
+            return -1;
+        }
+    }
+    res->reflink = cloned;
+
+    int done = cloned || resume;
+    if (!done && prepare_io(in_fd, out_fd, &st_src) != 0) { close(in_fd); close(out_fd); return -1; }
+    if (!done && opt_direct != DIRECT_OFF) {
+        int r = copy_direct(in_fd, out_fd, &st_src, res);
+        if (r < 0) { close(in_fd); close(out_fd); return -1; }
+        done = (r == 0);
+    }
+    if (!done) {
+        if (copy_data(in_fd, out_fd, &st_src, res) != 0) { close(in_fd); close(out_fd); return -1; }
+        drop_finish(in_fd, out_fd, res);
+    }
+    if (res->hash && verify_dest(out_fd, dst, res) != 0) { close(in_fd); close(out_fd); return -1; }
+    lap(&t, ph, PH_COPY);
+
+    //      ,     
+    if (opt_p && (!dst_exists || S_ISREG(st_dst.st_mode)) && preserve_meta(in_fd, out_fd, dst, &st_src) != 0) {
+        close(in_fd);
+        close(out_fd);
+        journal_close(&jn, dst, 0);
+        return -1;
+    }
+    lap(&t, ph, PH_META);
+
+    if (close(out_fd) < 0) { perror("close"); close(in_fd); journal_close(&jn, dst, 0); return -1; }
     close(in_fd);
+    if (resume) journal_close(&jn, dst, 1);
+    lap(&t, ph, PH_CLOSE);
+
+    if (opt_stats) {
+        pthread_mutex_lock(&stats.mu);
+        for (int i = 0; i < PH_COUNT; i++) stats.t[i] += ph[i];
+        stats.files++;
+        stats.bytes += S_ISREG(st_src.st_mode) ? (long long)st_src.st_size : res->written;
+        pthread_mutex_unlock(&stats.mu);
+    }
+
+    res->status = 0;
+    return 0;
+}
+
+//     (  -j/-r):    res 
+//   digest,    
+static int copy_file_at(const struct loc* src, const struct loc* dst, struct copy_result* res) {
+    struct hasher hash;
+    int rc = copy_one(src, dst, res, opt_verify != VERIFY_OFF ? &hash : NULL);
+    res->hash = NULL;
+    return rc;
+}
+
+static int copy_file(const char* src, const char* dst, struct copy_result* res) {
+    struct loc s = { AT_FDCWD, NULL, src }, d = { AT_FDCWD, NULL, dst };
+    return copy_file_at(&s, &d, res);
+}
+
+static void report(const struct loc* src, const struct loc* dst, const struct copy_result* res) {
+    if (!opt_v || res->status != 0) return;
+    char sbuf[PATH_MAX], dbuf[PATH_MAX];
+    if (res->skipped) { printf("skipped '%s'\n", loc_path(dst, dbuf, sizeof dbuf)); return; }
+    printf("'%s' -> '%s'", loc_path(src, sbuf, sizeof sbuf), loc_path(dst, dbuf, sizeof dbuf));
+    //    :   ,    
+    const char* sep = " (";
+    if (opt_reflink != REFLINK_NEVER) { printf("%s%s", sep, res->reflink ? "reflink" : "copy"); sep = ", "; }
+    if (res->sparse) { printf("%ssparse, %lld bytes written", sep, res->written); sep = ", "; }
+    if (res->resumed) { printf("%sresumed at %lld", sep, (long long)res->resumed); sep = ", "; }
+    if (res->direct) { printf("%sdirect, %s, %.1f MB/s", sep, res->direct, res->mbps); sep = ", "; }
+    if (res->verified) {
+        printf("%sverified %s %0*llx", sep, verify_names[opt_verify],
+               opt_verify == VERIFY_CRC32C ? 8 : 16, (unsigned long long)res->digest);
+        sep = ", ";
+    }
+    if (sep[0] == ',') putchar(')');
+    putchar('\n');
+}
+
+// ----    -j  -r ----
+
+//   . ,       
+// (is_file = 0, done = 1)      .
+struct entry {
+    struct loc src, dst;
+    int is_file;
+    struct copy_result res;
+    int done;
+};
+
+struct plan {
+    struct entry* v;
+    size_t n, cap;
+};
+
+//   -r.  ,     : 
+//   openat(),          .
+struct rdir {
+    DIR* d;          // SRC: readdir()  openat()    fd; NULL   
+    int dst_fd;
+    int created;     // DST     u+rwx
+    long pos;        //  : telldir(),    
+    dev_t dst_dev;   // DST    ,    ".."
+    ino_t dst_ino;
+    char* src_path;
+    char* dst_path;
+    struct stat st;  // SRC   -p   
+    struct rdir* next;
+};
+
+static int plan_push(struct plan* p, const struct loc* src, const struct loc* dst,
+                     int is_file, int status) {
+    if (p->n == p->cap) {
+        size_t cap = p->cap ? p->cap * 2 : 64;
+        struct entry* v = realloc(p->v, cap * sizeof *v);
+        if (!v) { perror("realloc"); return -1; }
+        p->v = v;
+        p->cap = cap;
+    }
+    struct entry* e = &p->v[p->n];
+    e->src = *src;
+    e->dst = *dst;
+    e->src.name = strdup(src->name);
+    e->dst.name = strdup(dst->name);
+    if (!e->src.name || !e->dst.name) {
+        perror("strdup");
+        free((char*)e->src.name);
+        free((char*)e->dst.name);
+        return -1;
+    }
+    e->is_file = is_file;
+    memset(&e->res, 0, sizeof e->res);
+    e->res.status = status;
+    e->done = !is_file;
+    p->n++;
+    return 0;
+}
 
-    if (opt_v) printf("'%s' -> '%s'\n", src, dst);
+//        
+static void plan_clear(struct plan* p) {
+    for (size_t i = 0; i < p->n; i++) {
+        free((char*)p->v[i].src.name);
+        free((char*)p->v[i].dst.name);
+    }
+    p->n = 0;
+}
+
+static void plan_free(struct plan* p) {
+    plan_clear(p);
+    free(p->v);
+}
+
+static int run_pool(struct plan* plan, int nthreads);
+
+// ---- -r:    openat/fstatat ----
+
+//    :    .
+// ,   ,    done,      ;
+//      ,   
+//       fd     .   fd
+//     ( ),  :
+//   , fd ,     
+//    ".." .
+struct walk {
+    struct plan* plan;
+    int have_root;
+    dev_t root_dev;  //  :    SRC,    
+    ino_t root_ino;
+    struct rdir* done;
+    struct rdir** done_tail;  //      
+    size_t open_dirs;
+    size_t max_dirs;
+    mode_t umask;
+    int rc;
+};
+
+static int copy_special_at(const struct loc* src, const struct loc* dst, const struct stat* st) {
+    char buf[PATH_MAX];
+    if (S_ISLNK(st->st_mode)) {
+        char target[PATH_MAX];
+        ssize_t n = readlinkat(src->dirfd, src->name, target, sizeof target - 1);
+        if (n < 0) { perror(loc_path(src, buf, sizeof buf)); return -1; }
+        target[n] = '\0';
+        if (symlinkat(target, dst->dirfd, dst->name) == 0) return opt_p ? preserve_meta(-1, -1, dst, st) : 0;
+        if (errno == EEXIST) {
+            (void)unlinkat(dst->dirfd, dst->name, 0);
+            if (symlinkat(target, dst->dirfd, dst->name) == 0) return opt_p ? preserve_meta(-1, -1, dst, st) : 0;
+        }
+        perror(loc_path(dst, buf, sizeof buf));
+        return -1;
+    }
+    // FIFO, ,    ,   
+    if (mknodat(dst->dirfd, dst->name, st->st_mode, st->st_rdev) != 0 && errno != EEXIST) {
+        perror(loc_path(dst, buf, sizeof buf));
+        return -1;
+    }
+    return opt_p ? preserve_meta(-1, -1, dst, st) : 0;
+}
+
+static void rdir_free(struct walk* w, struct rdir* rd) {
+    if (rd->d) {
+        closedir(rd->d);
+        w->open_dirs--;
+    }
+    if (rd->dst_fd >= 0) close(rd->dst_fd);
+    free(rd->src_path);
+    free(rd->dst_path);
+    free(rd);
+}
+
+//  -: ,    fd,  
+static void rdir_park(struct walk* w, struct rdir* rd) {
+    rd->pos = telldir(rd->d);
+    closedir(rd->d);
+    close(rd->dst_fd);
+    rd->d = NULL;
+    rd->dst_fd = -1;
+    w->open_dirs--;
+}
+
+//         .  
+//  dev/ino:    ,   .
+static int rdir_unpark(struct walk* w, struct rdir* rd, const struct rdir* child) {
+    struct stat sst, dst;
+    int sfd = openat(dirfd(child->d), "..", O_RDONLY | O_DIRECTORY);
+    int dfd = openat(child->dst_fd, "..", O_RDONLY | O_DIRECTORY);
+    int ok = sfd >= 0 && dfd >= 0 && fstat(sfd, &sst) == 0 && fstat(dfd, &dst) == 0;
+    if (ok && (sst.st_dev != rd->st.st_dev || sst.st_ino != rd->st.st_ino ||
+               dst.st_dev != rd->dst_dev || dst.st_ino != rd->dst_ino)) {
+        errno = ESTALE;
+        ok = 0;
+    }
+    if (!ok || (rd->d = fdopendir(sfd)) == NULL) {
+        fprintf(stderr, "cp: cannot return to '%s': %s\n", rd->src_path, strerror(errno));
+        if (sfd >= 0) close(sfd);
+        if (dfd >= 0) close(dfd);
+        return -1;
+    }
+    seekdir(rd->d, rd->pos);
+    rd->dst_fd = dfd;
+    w->open_dirs++;
     return 0;
 }
 
+//       .   
+//  :    ,   mtime,   
+// 0555     .  -p     SRC  umask.
+static void walk_flush(struct walk* w) {
+    // -i        
+    if (run_pool(w->plan, opt_i ? 1 : opt_j) != 0) w->rc = 1;
+    plan_clear(w->plan);
+    while (w->done) {
+        struct rdir* rd = w->done;
+        struct loc d = { AT_FDCWD, NULL, rd->dst_path };
+        if (opt_p) {
+            if (preserve_meta(dirfd(rd->d), rd->dst_fd, &d, &rd->st) != 0) w->rc = 1;
+        }
+        else if (rd->created && (rd->st.st_mode & S_IRWXU) != S_IRWXU &&
+                 fchmod(rd->dst_fd, rd->st.st_mode & 07777 & ~w->umask) != 0) {
+            fprintf(stderr, "cp: setting permissions for '%s': %s\n", rd->dst_path, strerror(errno));
+            w->rc = 1;
+        }
+        w->done = rd->next;
+        rdir_free(w, rd);
+    }
+    w->done_tail = &w->done;
+}
+
+//  SRC   DST   . NULL        .
+static struct rdir* open_dir(struct walk* w, const struct loc* src, const struct loc* dst, const struct stat* st) {
+    char buf[PATH_MAX];
+    int sfd = openat(src->dirfd, src->name, O_RDONLY | O_DIRECTORY);
+    if (sfd < 0) {
+        perror(loc_path(src, buf, sizeof buf));
+        plan_push(w->plan, src, dst, 0, -1);
+        return NULL;
+    }
+    int created = mkdirat(dst->dirfd, dst->name, (st->st_mode & 07777) | S_IRWXU) == 0;
+    if (!created && errno != EEXIST) {
+        perror(loc_path(dst, buf, sizeof buf));
+        plan_push(w->plan, src, dst, 0, -1);
+        close(sfd);
+        return NULL;
+    }
+    int dfd = openat(dst->dirfd, dst->name, O_RDONLY | O_DIRECTORY);
+    struct stat dst_st;
+    if (dfd < 0 || fstat(dfd, &dst_st) != 0) {
+        perror(loc_path(dst, buf, sizeof buf));
+        plan_push(w->plan, src, dst, 0, -1);
+        if (dfd >= 0) close(dfd);
+        close(sfd);
+        return NULL;
+    }
+    if (!w->have_root) {
+        w->have_root = 1;
+        w->root_dev = dst_st.st_dev;
+        w->root_ino = dst_st.st_ino;
+    }
+
+    struct rdir* rd = calloc(1, sizeof *rd);
+    if (!rd) {
+        perror("calloc");
+        plan_push(w->plan, src, dst, 0, -1);
+        close(sfd);
+        close(dfd);
+        return NULL;
+    }
+    w->open_dirs++;
+    rd->dst_fd = dfd;
+    rd->created = created;
+    rd->dst_dev = dst_st.st_dev;
+    rd->dst_ino = dst_st.st_ino;
+    rd->st = *st;
+    rd->src_path = strdup(loc_path(src, buf, sizeof buf));
+    rd->dst_path = strdup(loc_path(dst, buf, sizeof buf));
+    if (!rd->src_path || !rd->dst_path || (rd->d = fdopendir(sfd)) == NULL) {
+        perror(rd->src_path ? rd->src_path : "strdup");
+        plan_push(w->plan, src, dst, 0, -1);
+        close(sfd);
+        rdir_free(w, rd);
+        return NULL;
+    }
+    plan_push(w->plan, src, dst, 0, 0);
+    return rd;
+}
+
+static void walk_dir(struct walk* w, const struct loc* src, const struct loc* dst, const struct stat* st) {
+    char buf[PATH_MAX];
+    struct rdir** stack = malloc(16 * sizeof *stack);
+    size_t depth = 0, cap = 16;
+    if (!stack) { perror("malloc"); plan_push(w->plan, src, dst, 0, -1); return; }
+    if (w->open_dirs >= w->max_dirs) walk_flush(w);
+    if ((stack[0] = open_dir(w, src, dst, st)) != NULL) depth = 1;
+
+    while (depth > 0) {
+        struct rdir* rd = stack[depth - 1];
+        struct dirent* de = readdir(rd->d);
+        if (!de) {
+            //  ;     
+            depth--;
+            *w->done_tail = rd;
+            w->done_tail = &rd->next;
+            if (depth > 0 && !stack[depth - 1]->d && rdir_unpark(w, stack[depth - 1], rd) != 0) {
+                //       
+                w->rc = 1;
+                while (depth > 0) rdir_free(w, stack[--depth]);
+            }
+            //       done  ,  fd  
+            if (w->open_dirs >= w->max_dirs) walk_flush(w);
+            continue;
+        }
+        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0) continue;
+        int sfd = dirfd(rd->d);
+        struct loc cs = { sfd, rd->src_path, de->d_name };
+        struct loc cd = { rd->dst_fd, rd->dst_path, de->d_name };
+
+        //    d_type   stat     
+        if (de->d_type == DT_REG) { plan_push(w->plan, &cs, &cd, 1, 0); continue; }
+
+        struct stat cst;
+        if (fstatat(sfd, de->d_name, &cst, AT_SYMLINK_NOFOLLOW) != 0) {
+            perror(loc_path(&cs, buf, sizeof buf));
+            plan_push(w->plan, &cs, &cd, 0, -1);
+            continue;
+        }
+        if (S_ISREG(cst.st_mode)) {
+            plan_push(w->plan, &cs, &cd, 1, 0);
+        }
+        else if (S_ISDIR(cst.st_mode)) {
+            if (cst.st_dev == w->root_dev && cst.st_ino == w->root_ino) {
+                fprintf(stderr, "cp: cannot copy a directory into itself, '%s'\n",
+                        loc_path(&cs, buf, sizeof buf));
+                plan_push(w->plan, &cs, &cd, 0, -1);
+                continue;
+            }
+            if (depth == cap) {
+                struct rdir** s = realloc(stack, cap * 2 * sizeof *s);
+                if (!s) { perror("realloc"); plan_push(w->plan, &cs, &cd, 0, -1); continue; }
+                stack = s;
+                cap *= 2;
+            }
+            if (w->open_dirs >= w->max_dirs) {
+                walk_flush(w);
+                //     fd  :  ,  
+                if (w->open_dirs >= w->max_dirs / 2)
+                    for (size_t i = 0; i + 1 < depth; i++)
+                        if (stack[i]->d) rdir_park(w, stack[i]);
+            }
+            if ((stack[depth] = open_dir(w, &cs, &cd, &cst)) != NULL) depth++;
+        }
+        else {
+            plan_push(w->plan, &cs, &cd, 0, copy_special_at(&cs, &cd, &cst));
+        }
+    }
+    free(stack);
+}
+
+//    :  ->  ,   -r -> 
+static void add_source(struct walk* w, const char* src, const char* dst) {
+    struct loc s = { AT_FDCWD, NULL, src }, d = { AT_FDCWD, NULL, dst };
+    struct stat st;
+    if (opt_r && stat(src, &st) == 0 && S_ISDIR(st.st_mode)) {
+        w->have_root = 0;
+        walk_dir(w, &s, &d, &st);
+    }
+    else {
+        plan_push(w->plan, &s, &d, 1, 0);
+    }
+}
+
+// ----      ----
+
+//        [lo, hi)  .  
+//   (    ),    .
+struct wsdeque {
+    size_t lo, hi;
+    pthread_mutex_t mu;
+};
+
+struct pool {
+    struct plan* plan;
+    struct wsdeque* dq;
+    int nthreads;
+    pthread_mutex_t done_mu;
+    pthread_cond_t done_cv;  //  main,  -  
+};
+
+struct worker_arg {
+    struct pool* p;
+    int id;
+};
+
+static long take_job(struct pool* p, int self) {
+    struct wsdeque* own = &p->dq[self];
+    for (;;) {
+        pthread_mutex_lock(&own->mu);
+        if (own->lo < own->hi) {
+            size_t i = own->lo++;
+            pthread_mutex_unlock(&own->mu);
+            return (long)i;
+        }
+        pthread_mutex_unlock(&own->mu);
+
+        size_t lo = 0, hi = 0;
+        for (int k = 1; k < p->nthreads && lo == hi; k++) {
+            struct wsdeque* v = &p->dq[(self + k) % p->nthreads];
+            pthread_mutex_lock(&v->mu);
+            if (v->lo < v->hi) {
+                size_t mid = v->lo + (v->hi - v->lo) / 2;
+                lo = mid;
+                hi = v->hi;
+                v->hi = mid;
+            }
+            pthread_mutex_unlock(&v->mu);
+        }
+        if (lo == hi) return -1;  //      
+
+        pthread_mutex_lock(&own->mu);
+        own->lo = lo;
+        own->hi = hi;
+        pthread_mutex_unlock(&own->mu);
+    }
+}
+
+static void* pool_worker(void* arg) {
+    struct worker_arg* a = arg;
+    struct pool* p = a->p;
+    long i;
+    while ((i = take_job(p, a->id)) >= 0) {
+        struct entry* e = &p->plan->v[i];
+        if (!e->is_file) continue;
+
+        copy_file_at(&e->src, &e->dst, &e->res);
+
+        pthread_mutex_lock(&p->done_mu);
+        e->done = 1;
+        pthread_cond_broadcast(&p->done_cv);
+        pthread_mutex_unlock(&p->done_mu);
+    }
+    return NULL;
+}
+
+//     ;    1,     .
+// main        -v,    .
+static int run_pool(struct plan* plan, int nthreads) {
+    if (plan->n == 0) return 0;
+    if ((size_t)nthreads > plan->n) nthreads = (int)plan->n;
+
+    struct wsdeque dq[MAX_JOBS];
+    pthread_t tid[MAX_JOBS];
+    struct worker_arg args[MAX_JOBS];
+    struct pool p = { plan, dq, nthreads, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER };
+
+    //     ,   
+    for (int t = 0; t < nthreads; t++) {
+        dq[t].lo = plan->n * (size_t)t / (size_t)nthreads;
+        dq[t].hi = plan->n * (size_t)(t + 1) / (size_t)nthreads;
+        pthread_mutex_init(&dq[t].mu, NULL);
+    }
+
+    int started = 0;
+    for (int t = 0; t < nthreads; t++) {
+        args[t].p = &p;
+        args[t].id = t;
+        int e = pthread_create(&tid[t], NULL, pool_worker, &args[t]);
+        if (e != 0) {
+            errno = e;
+            perror("pthread_create");
+            break;
+        }
+        started++;
+    }
+    //          (    )
+    if (started == 0) pool_worker(&args[0]);
+
+    int rc = 0;
+    for (size_t i = 0; i < plan->n; i++) {
+        struct entry* e = &plan->v[i];
+        pthread_mutex_lock(&p.done_mu);
+        while (!e->done) pthread_cond_wait(&p.done_cv, &p.done_mu);
+        pthread_mutex_unlock(&p.done_mu);
+        report(&e->src, &e->dst, &e->res);
+        if (e->res.status != 0) rc = 1;
+    }
+    for (int t = 0; t < started; t++) pthread_join(tid[t], NULL);
+    for (int t = 0; t < nthreads; t++) pthread_mutex_destroy(&dq[t].mu);
+    return rc;
+}
+
+//       fd      
+//  ,     .   
+// (SRC, DEST   --resume  )  stdio.
+static size_t max_open_dirs(void) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) != 0) return 256;
+    if (rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        if (setrlimit(RLIMIT_NOFILE, &rl) != 0) (void)getrlimit(RLIMIT_NOFILE, &rl);
+    }
+    rlim_t reserve = 16 + 3 * (rlim_t)opt_j;
+    if (rl.rlim_cur == RLIM_INFINITY || rl.rlim_cur > 1 << 20) return 1 << 18;
+    return rl.rlim_cur > reserve + 32 ? (size_t)(rl.rlim_cur - reserve) / 2 : 16;
+}
+
+static double run_t0;  //       finish()
+
+//    :   
+static int finish(int rc) {
+    fflush(stdout);  //   stderr     -v
+    if (opt_direct != DIRECT_OFF && direct_bytes > 0) {
+        double dt = now_sec() - run_t0;
+        fprintf(stderr, "direct: %lld bytes in %.3f s, %.1f MB/s sustained\n",
+                direct_bytes, dt, dt > 0 ? (double)direct_bytes / dt / 1e6 : 0.0);
+    }
+    if (opt_stats) {
+        double dt = now_sec() - run_t0;
+        fprintf(stderr, "stats: %lld files, %lld bytes in %.3f s: %.1f files/s, %.1f MB/s\n",
+                stats.files, stats.bytes, dt,
+                dt > 0 ? (double)stats.files / dt : 0.0,
+                dt > 0 ? (double)stats.bytes / dt / 1e6 : 0.0);
+        fprintf(stderr, "stats: phases (summed over threads):");
+        for (int i = 0; i < PH_COUNT; i++)
+            fprintf(stderr, "%s %s %.3f s", i ? "," : "", phase_names[i], stats.t[i]);
+        fputc('\n', stderr);
+    }
+    return rc;
+}
+
 int main(int argc, char* argv[]) {
     static struct option long_opts[] = {
         {"force",       no_argument, 0, 'f'},
         {"interactive", no_argument, 0, 'i'},
         {"verbose",     no_argument, 0, 'v'},
+        {"recursive",   no_argument, 0, 'r'},
+        {"preserve",    no_argument, 0, 'p'},
+        {"engine",      required_argument, 0, OPT_ENGINE},
+        {"sparse",      required_argument, 0, OPT_SPARSE},
+        {"reflink",     optional_argument, 0, OPT_REFLINK},
+        {"direct",      optional_argument, 0, OPT_DIRECT},
+        {"no-preallocate", no_argument,    0, OPT_NO_PREALLOC},
+        {"drop-behind", required_argument, 0, OPT_DROP_BEHIND},
+        {"stats",       no_argument,       0, OPT_STATS},
+        {"resume",      optional_argument, 0, OPT_RESUME},
+        {"verify",      required_argument, 0, OPT_VERIFY},
         {0, 0, 0, 0}
     };
 
     int ch;
-    while ((ch = getopt_long(argc, argv, "fiv", long_opts, NULL)) != -1) {
+    while ((ch = getopt_long(argc, argv, "fivrRpj:", long_opts, NULL)) != -1) {
         switch (ch) {
         case 'f': opt_f = 1; break;
         case 'i': opt_i = 1; break;
         case 'v': opt_v = 1; break;
+        case 'r':
+        case 'R': opt_r = 1; break;
+        case 'p': opt_p = 1; break;
+        case 'j': {
+            char* end;
+            long v = strtol(optarg, &end, 10);
+            if (*end != '\0' || v < 1 || v > MAX_JOBS) {
+                fprintf(stderr, "invalid -j value '%s' (1..%d)\n", optarg, MAX_JOBS);
+                usage(argv[0]);
+            }
+            opt_j = (int)v;
+            break;
+        }
+        case OPT_ENGINE: {
+            int e = parse_name(optarg, engine_names, sizeof engine_names / sizeof engine_names[0]);
+            if (e < 0) {
+                fprintf(stderr, "unknown engine '%s'\n", optarg);
+                usage(argv[0]);
+            }
+            opt_engine = (enum copy_engine)e;
+            break;
+        }
+        case OPT_SPARSE: {
+            int m = parse_name(optarg, sparse_names, sizeof sparse_names / sizeof sparse_names[0]);
+            if (m < 0) {
+                fprintf(stderr, "invalid --sparse value '%s'\n", optarg);
+                usage(argv[0]);
+            }
+            opt_sparse = (enum sparse_mode)m;
+            break;
+        }
+        case OPT_REFLINK: {
+            int m = optarg ? parse_name(optarg, reflink_names, sizeof reflink_names / sizeof reflink_names[0])
+                           : REFLINK_ALWAYS;
+            if (m < 0) {
+                fprintf(stderr, "invalid --reflink value '%s'\n", optarg);
+                usage(argv[0]);
+            }
+            opt_reflink = (enum reflink_mode)m;
+            break;
+        }
+        case OPT_DIRECT: {
+            int m = optarg ? parse_name(optarg, direct_names, sizeof direct_names / sizeof direct_names[0])
+                           : DIRECT_AUTO;
+            if (m < 0) {
+                fprintf(stderr, "invalid --direct value '%s'\n", optarg);
+                usage(argv[0]);
+            }
+            opt_direct = (enum direct_mode)m;
+            break;
+        }
+        case OPT_NO_PREALLOC: opt_prealloc = 0; break;
+        case OPT_STATS: opt_stats = 1; break;
+        case OPT_RESUME: {
+            int m = optarg ? parse_name(optarg, resume_names, sizeof resume_names / sizeof resume_names[0])
+                           : RESUME_OFFSETS;
+            if (m < 0) {
+                fprintf(stderr, "invalid --resume value '%s'\n", optarg);
+                usage(argv[0]);
+            }
+            opt_resume = (enum resume_mode)m;
+            break;
+        }
+        case OPT_VERIFY: {
+            // ALG[,direct]
+            char alg[32];
+            const char* comma = strchr(optarg, ',');
+            size_t len = comma ? (size_t)(comma - optarg) : strlen(optarg);
+            int m = -1;
+            if (len < sizeof alg) {
+                memcpy(alg, optarg, len);
+                alg[len] = '\0';
+                m = parse_name(alg, verify_names, sizeof verify_names / sizeof verify_names[0]);
+            }
+            if (m < 0 || (comma && strcmp(comma + 1, "direct") != 0)) {
+                fprintf(stderr, "invalid --verify value '%s'\n", optarg);
+                usage(argv[0]);
+            }
+            opt_verify = (enum verify_mode)m;
+            opt_verify_direct = comma != NULL;
+            break;
+        }
+        case OPT_DROP_BEHIND:
+            if (parse_size(optarg, &opt_drop_window) != 0) {
+                fprintf(stderr, "invalid --drop-behind size '%s'\n", optarg);
+                usage(argv[0]);
+            }
+            break;
         default: usage(argv[0]);
         }
     }
@@ -125,18 +2117,61 @@ int main(int argc, char* argv[]) {
     int n_args = argc - optind;
     if (n_args < 2) usage(argv[0]);
 
+    // --verify     ;     
+    if (opt_verify != VERIFY_OFF) {
+        const char* clash = opt_direct != DIRECT_OFF ? "--direct"
+                          : opt_resume != RESUME_OFF ? "--resume"
+                          : opt_reflink != REFLINK_NEVER ? "--reflink"
+                          : (opt_engine == ENGINE_CFR || opt_engine == ENGINE_SENDFILE) ? engine_names[opt_engine]
+                          : NULL;
+        if (clash) {
+            fprintf(stderr, "--verify cannot be combined with %s\n", clash);
+            usage(argv[0]);
+        }
+    }
+
     const char* dest = argv[argc - 1];
     struct stat st;
     int dest_is_dir = (stat(dest, &st) == 0 && S_ISDIR(st.st_mode));
 
-    if (n_args == 2 && !dest_is_dir) {
-        // SRC -> DEST
-        return copy_file(argv[optind], dest) ? 1 : 0;
+    if (n_args > 2 && !dest_is_dir) {
+        fprintf(stderr, "target '%s' is not a directory\n", dest);
+        return 1;
+    }
+
+    run_t0 = now_sec();
+
+    // -r / -j:   (  ),   
+    if (opt_r || (opt_j > 1 && !opt_i && dest_is_dir)) {
+        struct plan plan = { NULL, 0, 0 };
+        struct walk w = { &plan, 0, 0, 0, NULL, NULL, 0, 0, 0, 0 };
+        w.done_tail = &w.done;
+        w.max_dirs = opt_r ? max_open_dirs() : 0;
+        w.umask = umask(0);
+        umask(w.umask);
+        if (!dest_is_dir) {
+            add_source(&w, argv[optind], dest);
+        }
+        else {
+            for (int i = optind; i < argc - 1; i++) {
+                char scratch[PATH_MAX];
+                char path[PATH_MAX];
+                join_path(path, sizeof path, dest, filename_of(argv[i], scratch, sizeof scratch));
+                add_source(&w, argv[i], path);
+            }
+        }
+        walk_flush(&w);
+        plan_free(&plan);
+        return finish(w.rc);
     }
 
     if (!dest_is_dir) {
-        fprintf(stderr, "target '%s' is not a directory\n", dest);
-        return 1;
+        // SRC -> DEST
+        struct loc s = { AT_FDCWD, NULL, argv[optind] }, d = { AT_FDCWD, NULL, dest };
+        struct copy_result res;
+        if (copy_file(argv[optind], dest, &res) != 0) return finish(1);
+        report(&s, &d, &res);
+        return finish(0);
     }
 
     // SRC... -> DIR
@@ -145,8 +2180,11 @@ int main(int argc, char* argv[]) {
         const char* base = filename_of(argv[i], scratch, sizeof scratch);
         char path[PATH_MAX];
         join_path(path, sizeof path, dest, base);
-        if (copy_file(argv[i], path) != 0) return 1;
+        struct loc s = { AT_FDCWD, NULL, argv[i] }, d = { AT_FDCWD, NULL, path };
+        struct copy_result res;
+        if (copy_file(argv[i], path, &res) != 0) return finish(1);
+        report(&s, &d, &res);
     }
 
-    return 0;
-}
\ No newline at end of file
+    return finish(0);
+}
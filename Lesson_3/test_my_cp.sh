@@ -135,6 +135,148 @@ say "Бинарный файл (cmp == OK)"
 expect_ok   "'$BIN' -v bin.dat testdir/"
 expect_ok   "cmp -s bin.dat testdir/bin.dat"
 
+say "Движки копирования (--engine=...)"
+for eng in auto copy_file_range sendfile rw; do
+  expect_ok   "'$BIN' --engine=$eng bin.dat testdir/bin.$eng"
+  expect_ok   "cmp -s bin.dat testdir/bin.$eng"
+  expect_ok   "'$BIN' --engine=$eng empty.txt testdir/empty.$eng"
+  expect_wc_bytes 0 testdir/empty.$eng
+  # st_size у /proc нулевой, но данные есть — копия не должна выйти пустой
+  expect_ok   "'$BIN' --engine=$eng /proc/self/status testdir/status.$eng && [ -s testdir/status.$eng ]"
+done
+( sleep 0.1; printf 'fifo\n' > p1 ) &
+expect_ok   "'$BIN' --engine=auto p1 testdir/p1.auto"
+expect_diff_eq /tmp/expected_fifo.txt testdir/p1.auto
+expect_fail "'$BIN' --engine=nosuch file1.txt testdir/"
+
+say "-j N: параллельное копирование в директорию"
+mkdir -p jdir && rm -f jdir/*
+expect_ok   "'$BIN' -j 4 file1.txt file2.txt empty.txt bin.dat jdir/"
+expect_ok   "cmp -s bin.dat jdir/bin.dat"
+expect_diff_eq file2.txt jdir/file2.txt
+# -v сохраняет порядок аргументов
+expect_ok   "'$BIN' -v -j 4 file1.txt file2.txt bin.dat jdir/ | cut -d\\' -f2 | tr '\\n' ' ' | grep -qx 'file1.txt file2.txt bin.dat '"
+# ошибка одного файла не останавливает остальные, но код возврата ненулевой
+rm -f jdir/*
+expect_fail "'$BIN' -j 4 file1.txt no_such.txt file2.txt jdir/"
+expect_diff_eq file2.txt jdir/file2.txt
+expect_fail "'$BIN' -j 0 file1.txt jdir/"
+
+say "-r: рекурсивное копирование дерева"
+mkdir -p tree/a/b/c tree/e
+for i in 1 2 3 4 5 6 7 8; do printf "$i\n" > tree/a/f$i; printf "$i$i\n" > tree/a/b/c/g$i; done
+cp bin.dat tree/e/bin.dat
+ln -sf f1 tree/a/lnk
+expect_fail "'$BIN' tree rtree"
+expect_ok   "'$BIN' -r tree rtree"
+expect_ok   "diff -r tree rtree"
+expect_ok   "[ -L rtree/a/lnk ] && [ \"\$(readlink rtree/a/lnk)\" = f1 ]"
+expect_ok   "'$BIN' -R -j 4 tree file1.txt testdir/"
+expect_ok   "diff -r tree testdir/tree"
+expect_diff_eq file1.txt testdir/file1.txt
+expect_fail "'$BIN' -r tree tree/a"
+# широкое дерево: каталогов больше, чем разрешено fd; глубокое — больше, чем влезло бы в стек
+rm -rf wide deep && mkdir -p wide deep
+for i in $(seq 1 600); do mkdir wide/d$i && printf "$i\n" > wide/d$i/f; done
+(cd deep && for i in $(seq 1 1000); do mkdir d && cd d || exit; done && printf "x\n" > f)
+expect_ok   "(ulimit -n 64; '$BIN' -r -j 2 wide testdir/wide)"
+expect_ok   "diff -r wide testdir/wide"
+expect_ok   "'$BIN' -r deep testdir/deep"
+expect_ok   "diff -r deep testdir/deep"
+# глубина больше лимита fd: предки закрываются и открываются заново через ".."
+expect_ok   "(ulimit -n 64; '$BIN' -r -j 2 deep testdir/deep_lim)"
+expect_ok   "diff -r deep testdir/deep_lim"
+# без -p временный u+rwx снимается: права SRC с учётом umask
+rm -rf modes && mkdir -p modes/ro && printf "x\n" > modes/ro/f && chmod 555 modes/ro
+expect_ok   "(umask 022; '$BIN' -r modes testdir/modes)"
+expect_ok   "[ \"\$(stat -c %a testdir/modes/ro)\" = 555 ] && [ -s testdir/modes/ro/f ]"
+chmod 755 modes/ro
+
+say "--sparse: дыры сохраняются, содержимое то же"
+truncate -s 8M holes.img
+dd if=/dev/urandom of=holes.img bs=64K count=1 seek=40 conv=notrunc status=none
+for mode in auto always never; do
+  expect_ok   "'$BIN' --sparse=$mode holes.img testdir/holes.$mode"
+  expect_ok   "cmp -s holes.img testdir/holes.$mode"
+done
+expect_ok   "[ \$(stat -c %b testdir/holes.auto) -lt \$(stat -c %b testdir/holes.never) ]"
+{ head -c 300000 /dev/zero; printf 'tail'; } > zeros.dat
+expect_ok   "'$BIN' --sparse=always zeros.dat testdir/zeros.dat"
+expect_ok   "cmp -s zeros.dat testdir/zeros.dat"
+expect_fail "'$BIN' --sparse=sometimes file1.txt testdir/"
+
+say "--reflink: клон или откат на копирование"
+expect_ok   "'$BIN' -v --reflink=auto bin.dat testdir/bin.reflink | grep -Eq '\\((reflink|copy)'"
+expect_ok   "cmp -s bin.dat testdir/bin.reflink"
+# --reflink=always на ФС без CoW должен упасть, но не испортить данные
+if "$BIN" --reflink=always bin.dat testdir/bin.clone 2>/dev/null; then
+  expect_ok "cmp -s bin.dat testdir/bin.clone"
+else
+  expect_fail "[ -e testdir/bin.clone ]"
+fi
+expect_fail "'$BIN' --reflink=maybe file1.txt testdir/"
+
+say "--direct: O_DIRECT + асинхронный конвейер"
+head -c 3000001 /dev/urandom > odd.dat   # не кратно блоку — проверяем хвост
+for io in auto aio; do
+  expect_ok   "'$BIN' --direct=$io odd.dat testdir/odd.$io 2>/dev/null"
+  expect_ok   "cmp -s odd.dat testdir/odd.$io"
+done
+expect_ok   "'$BIN' --direct file1.txt testdir/direct.txt 2>&1 | grep -q 'MB/s'"
+expect_diff_eq file1.txt testdir/direct.txt
+
+say "Preallocate и --drop-behind не меняют содержимое"
+for eng in auto rw sendfile; do
+  expect_ok   "'$BIN' --engine=$eng --drop-behind=64K bin.dat testdir/bin.drop.$eng"
+  expect_ok   "cmp -s bin.dat testdir/bin.drop.$eng"
+done
+expect_ok   "'$BIN' --no-preallocate bin.dat testdir/bin.noprealloc"
+expect_ok   "cmp -s bin.dat testdir/bin.noprealloc"
+expect_fail "'$BIN' --drop-behind=lots bin.dat testdir/"
+
+say "--stats: сводка в stderr"
+expect_ok   "'$BIN' --stats file1.txt bin.dat testdir/ 2>&1 >/dev/null | grep '^stats: 2 files, 1048582 bytes' >/dev/null"
+expect_ok   "'$BIN' --stats -r -j 2 tree testdir/stats_tree 2>&1 >/dev/null | grep 'open .* stat .* copy .* close' >/dev/null"
+
+say "--resume: журнал рядом с DEST"
+for mode in offsets crc32c; do
+  expect_ok   "'$BIN' --resume=$mode bin.dat testdir/bin.resume.$mode"
+  expect_ok   "cmp -s bin.dat testdir/bin.resume.$mode"
+  expect_fail "[ -e testdir/bin.resume.$mode.mycp-journal ]"
+done
+# чужой/битый журнал не должен приниматься на веру
+printf 'garbage' > testdir/bin.resume.junk.mycp-journal
+printf 'OLD CONTENT' > testdir/bin.resume.junk
+expect_ok   "'$BIN' --resume bin.dat testdir/bin.resume.junk"
+expect_ok   "cmp -s bin.dat testdir/bin.resume.junk"
+expect_fail "'$BIN' --resume=later bin.dat testdir/"
+
+say "--verify: хеш при копировании, сверка с DEST"
+printf '123456789' > check.txt
+expect_ok   "'$BIN' -v --verify=crc32c check.txt testdir/ | grep 'verified crc32c e3069283' >/dev/null"
+expect_ok   "'$BIN' -v --verify=xxh64 check.txt testdir/ | grep 'verified xxh64 8cb841db40e6ae83' >/dev/null"
+for alg in xxh64 crc32c xxh64,direct; do
+  expect_ok   "'$BIN' --verify=$alg bin.dat testdir/bin.verify"
+  expect_ok   "cmp -s bin.dat testdir/bin.verify"
+done
+expect_ok   "'$BIN' -v --verify=xxh64 holes.img testdir/holes.verify | grep 'sparse.*verified' >/dev/null"
+expect_ok   "cmp -s holes.img testdir/holes.verify"
+expect_fail "'$BIN' --verify=md5 file1.txt testdir/"
+expect_fail "'$BIN' --verify=xxh64 --direct file1.txt testdir/"
+
+say "-p: права, время, владелец, xattr"
+cp file1.txt keep.txt && chmod 640 keep.txt && touch -d '2001-02-03 04:05:06' keep.txt
+expect_ok   "'$BIN' -p keep.txt testdir/keep.txt"
+expect_ok   "[ \"\$(stat -c '%a %Y %u:%g' keep.txt)\" = \"\$(stat -c '%a %Y %u:%g' testdir/keep.txt)\" ]"
+chmod 750 tree/a && touch -d '2002-01-01' tree/a && touch -h -d '2002-01-01' tree/a/lnk
+expect_ok   "'$BIN' --preserve -r tree testdir/ptree"
+expect_ok   "[ \"\$(stat -c '%a %Y' tree/a)\" = \"\$(stat -c '%a %Y' testdir/ptree/a)\" ]"
+expect_ok   "[ \"\$(stat -c %Y tree/a/lnk)\" = \"\$(stat -c %Y testdir/ptree/a/lnk)\" ]"
+if command -v setfattr >/dev/null && setfattr -n user.mycp -v 42 keep.txt 2>/dev/null; then
+  expect_ok   "'$BIN' -p keep.txt testdir/keep.xattr"
+  expect_ok   "getfattr -n user.mycp --only-values testdir/keep.xattr | grep -x 42 >/dev/null"
+fi
+
 say "Нечитаемый SRC"
 cp file1.txt ro_src.txt && chmod 000 ro_src.txt
 expect_fail "'$BIN' ro_src.txt testdir/"
@@ -0,0 +1,84 @@
+#!/usr/bin/env bash
+# bench_counter.sh — замеры для lesson4_counter: ядра подсчёта (scalar/sse2/avx2/avx512), -j N, --tee
+# Запуск: bash bench_counter.sh /path/to/mywc [SIZE_MB]
+
+set -euo pipefail
+
+BIN_INPUT="${1:-./mywc}"
+case "$BIN_INPUT" in
+  /*) BIN="$BIN_INPUT" ;;
+  *)  BIN="$(pwd)/$BIN_INPUT" ;;
+esac
+SIZE_MB="${2:-512}"
+
+WORK="/tmp/counter_bench"
+rm -rf "$WORK" && mkdir -p "$WORK"
+cd "$WORK"
+
+now(){ date +%s.%N; }
+# Сбросить page cache, чтобы прогоны были честными (нужен root; иначе — как есть)
+drop_caches(){ sync; echo 3 > /proc/sys/vm/drop_caches 2>/dev/null || true; }
+gbps(){ awk "BEGIN{printf \"%.2f\", $SIZE_MB * 1048576 / 1e9 / ($2 - $1)}"; }
+
+# Текст: base64 со «словами» и строками разной длины; файл в page cache,
+# так что меряется подсчёт плюс read, а не диск
+head -c $((SIZE_MB * 1024 * 1024 * 3 / 4 + 4096)) /dev/urandom | base64 -w 0 | tr '+/' ' \n' \
+  | head -c $((SIZE_MB * 1024 * 1024)) > text
+cat text > /dev/null
+
+printf "\n== kernels: %s MiB, GB/s (stdin из page cache) ==\n" "$SIZE_MB"
+printf "%-8s %8s %8s  %s\n" "kernel" "time, s" "GB/s" "bytes words lines"
+ref=""
+for k in scalar sse2 avx2 avx512 auto; do
+  t0=$(now)
+  if ! out=$("$BIN" --kernel="$k" < text 2>/dev/null); then
+    printf "%-8s %8s %8s  %s\n" "$k" "-" "-" "(не поддерживается процессором)"
+    continue
+  fi
+  t1=$(now)
+  [ -n "$ref" ] || ref=$out
+  [ "$out" = "$ref" ] || { echo "MISMATCH: $k: $out vs $ref" >&2; exit 1; }
+  printf "%-8s %8.3f %8s  %s\n" "$k" "$(awk "BEGIN{print $t1 - $t0}")" "$(gbps "$t0" "$t1")" "$out"
+done
+
+# Потолок: сам read из page cache без подсчёта
+t0=$(now); cat text > /dev/null; t1=$(now)
+printf "%-8s %8.3f %8s\n" "cat" "$(awk "BEGIN{print $t1 - $t0}")" "$(gbps "$t0" "$t1")"
+
+# --- -j N: куски файла параллельно через pread, итог должен совпасть с -j 1 ---
+printf "\n== -j: %s MiB, ядер %s ==\n" "$SIZE_MB" "$(nproc)"
+printf "%-5s %4s %8s %8s %9s\n" "cache" "-j" "time, s" "GB/s" "speed-up"
+for cache in cold warm; do
+  base=""
+  for jobs in 1 2 4 8; do
+    if [ "$cache" = cold ]; then drop_caches; else cat text > /dev/null; fi
+    t0=$(now)
+    out=$("$BIN" -j "$jobs" < text)
+    t1=$(now)
+    [ "$out" = "$ref" ] || { echo "MISMATCH: -j $jobs: $out vs $ref" >&2; exit 1; }
+    t=$(awk "BEGIN{print $t1 - $t0}")
+    [ -n "$base" ] || base=$t
+    printf "%-5s %4s %8.3f %8s %8.2fx\n" "$cache" "$jobs" "$t" "$(gbps "$t0" "$t1")" "$(awk "BEGIN{print $base / $t}")"
+  done
+done
+
+# --- --tee: во сколько обходится подсчёт, если данные должны идти дальше ---
+# Потребитель — cat > /dev/null; данные сверяются по размеру, счёт — с эталоном
+printf "\n== --tee: %s MiB через пайплайн ==\n" "$SIZE_MB"
+printf "%-40s %8s %8s\n" "pipeline" "time, s" "GB/s"
+for mode in "cat | cat" "mywc --tee cat | cat" "cat | mywc --tee | cat" "mywc --tee < file | cat"; do
+  cat text > /dev/null
+  t0=$(now)
+  case "$mode" in
+    "cat | cat")               n=$(cat text | cat | wc -c); counts=$ref ;;
+    "mywc --tee cat | cat")    n=$("$BIN" --tee cat text 2>counts | cat | wc -c); counts=$(cat counts) ;;
+    "cat | mywc --tee | cat")  n=$(cat text | "$BIN" --tee 2>counts | cat | wc -c); counts=$(cat counts) ;;
+    "mywc --tee < file | cat") n=$("$BIN" --tee < text 2>counts | cat | wc -c); counts=$(cat counts) ;;
+  esac
+  t1=$(now)
+  [ "$n" -eq $((SIZE_MB * 1024 * 1024)) ] && [ "$counts" = "$ref" ] \
+    || { echo "MISMATCH: $mode: $n bytes, $counts" >&2; exit 1; }
+  printf "%-40s %8.3f %8s\n" "$mode" "$(awk "BEGIN{print $t1 - $t0}")" "$(gbps "$t0" "$t1")"
+done
+
+rm -rf "$WORK"
@@ -1,12 +1,26 @@
 #define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
 #include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#define BUF_SIZE (64 * 1024)
+#define MAX_JOBS 64
+#define MIN_CHUNK (1 << 20) //      :  
 
 typedef struct {
     unsigned long long bytes;
@@ -14,25 +28,142 @@ typedef struct {
     unsigned long long lines;
 } Counts;
 
-static void count_fd(int fd, Counts* c)
+enum kernel_kind { K_AUTO, K_AVX512, K_AVX2, K_SSE2, K_SCALAR };
+
+static const char* const kernel_name[] = { "auto", "avx512", "avx2", "sse2", "scalar" };
+
+// :   isspace ( "C"  setlocale  )
+static void count_scalar(const unsigned char* p, size_t n, Counts* c, int* in_word)
+{
+    for (size_t i = 0; i < n; ++i) {
+        unsigned char ch = p[i];
+        if (ch == '\n') c->lines++;
+        if (isspace(ch)) {
+            *in_word = 0;
+        }
+        else if (!*in_word) {
+            c->words++;
+            *in_word = 1;
+        }
+    }
+}
+
+#if defined(__x86_64__)
+//      64 : sp    
+// (' '  0x09..0x0d,  isspace   "C"), nl   '\n'.
+//     ,   :
+//     starts = ~sp & (sp << 1 | prev),
+//  prev        .
+//     popcount ;    .  < 64   .
+
+static inline void tally(uint64_t sp, uint64_t nl, uint64_t* prev, Counts* c)
+{
+    c->lines += (unsigned long long)__builtin_popcountll(nl);
+    c->words += (unsigned long long)__builtin_popcountll(~sp & (sp << 1 | *prev));
+    *prev = sp >> 63;
+}
+
+// 16 : ,  == ' '  (b - 9) <= 4  
+static inline void masks16(const unsigned char* p, unsigned* sp, unsigned* nl)
 {
-    char buf[8192];
+    const __m128i v = _mm_loadu_si128((const __m128i*)p);
+    const __m128i t = _mm_sub_epi8(v, _mm_set1_epi8(9));
+    const __m128i ctl = _mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8(4)), t);
+    *sp = (unsigned)_mm_movemask_epi8(_mm_or_si128(ctl, _mm_cmpeq_epi8(v, _mm_set1_epi8(' '))));
+    *nl = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+}
+
+static void count_sse2(const unsigned char* p, size_t n, Counts* c, int* in_word)
+{
+    uint64_t prev = !*in_word;
+
+    for (; n >= 64; p += 64, n -= 64) {
+        unsigned s0, s1, s2, s3, n0, n1, n2, n3;
+        masks16(p, &s0, &n0);
+        masks16(p + 16, &s1, &n1);
+        masks16(p + 32, &s2, &n2);
+        masks16(p + 48, &s3, &n3);
+        tally(s0 | (uint64_t)s1 << 16 | (uint64_t)s2 << 32 | (uint64_t)s3 << 48,
+              n0 | (uint64_t)n1 << 16 | (uint64_t)n2 << 32 | (uint64_t)n3 << 48, &prev, c);
+    }
+    *in_word = !prev;
+    count_scalar(p, n, c, in_word);
+}
+
+__attribute__((target("avx2,popcnt")))
+static inline void masks32(const unsigned char* p, uint32_t* sp, uint32_t* nl)
+{
+    const __m256i v = _mm256_loadu_si256((const __m256i*)p);
+    const __m256i t = _mm256_sub_epi8(v, _mm256_set1_epi8(9));
+    const __m256i ctl = _mm256_cmpeq_epi8(_mm256_min_epu8(t, _mm256_set1_epi8(4)), t);
+    *sp = (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(ctl, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '))));
+    *nl = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+}
+
+__attribute__((target("avx2,popcnt")))
+static void count_avx2(const unsigned char* p, size_t n, Counts* c, int* in_word)
+{
+    uint64_t prev = !*in_word;
+
+    for (; n >= 64; p += 64, n -= 64) {
+        uint32_t s0, s1, n0, n1;
+        masks32(p, &s0, &n0);
+        masks32(p + 32, &s1, &n1);
+        tally(s0 | (uint64_t)s1 << 32, n0 | (uint64_t)n1 << 32, &prev, c);
+    }
+    *in_word = !prev;
+    count_scalar(p, n, c, in_word);
+}
+
+__attribute__((target("avx512bw,popcnt")))
+static void count_avx512(const unsigned char* p, size_t n, Counts* c, int* in_word)
+{
+    uint64_t prev = !*in_word;
+
+    for (; n >= 64; p += 64, n -= 64) {
+        const __m512i v = _mm512_loadu_si512((const void*)p);
+        uint64_t sp = _mm512_cmple_epu8_mask(_mm512_sub_epi8(v, _mm512_set1_epi8(9)), _mm512_set1_epi8(4)) |
+                      _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8(' '));
+        uint64_t nl = _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('\n'));
+        tally(sp, nl, &prev, c);
+    }
+    *in_word = !prev;
+    count_scalar(p, n, c, in_word);
+}
+#endif
+
+static void (*count_buf)(const unsigned char*, size_t, Counts*, int*) = count_scalar;
+
+//  :       --kernel=
+static int kernel_init(enum kernel_kind k)
+{
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (k == K_AUTO)
+        k = __builtin_cpu_supports("avx512bw") ? K_AVX512 :
+            __builtin_cpu_supports("avx2") ? K_AVX2 : K_SSE2;
+    if (k == K_AVX512 && !__builtin_cpu_supports("avx512bw"))
+        return -1;
+    if (k == K_AVX2 && !__builtin_cpu_supports("avx2"))
+        return -1;
+    if (k == K_AVX512) count_buf = count_avx512;
+    if (k == K_AVX2) count_buf = count_avx2;
+    if (k == K_SSE2) count_buf = count_sse2;
+#else
+    if (k != K_AUTO && k != K_SCALAR)
+        return -1;
+#endif
+    return 0;
+}
+
+static void count_stream(int fd, Counts* c, int* in_word)
+{
+    unsigned char buf[BUF_SIZE];
     ssize_t n;
-    int in_word = 0;
 
     while ((n = read(fd, buf, sizeof buf)) > 0) {
         c->bytes += (unsigned long long)n;
-        for (ssize_t i = 0; i < n; ++i) {
-            unsigned char ch = (unsigned char)buf[i];
-            if (ch == '\n') c->lines++;
-            if (isspace(ch)) {
-                in_word = 0;
-            }
-            else if (!in_word) {
-                c->words++;
-                in_word = 1;
-            }
-        }
+        count_buf(buf, (size_t)n, c, in_word);
     }
     if (n < 0) {
         perror("read");
@@ -40,13 +171,311 @@ static void count_fd(int fd, Counts* c)
     }
 }
 
+static void count_fd(int fd, Counts* c)
+{
+    int in_word = 0;
+    count_stream(fd, c, &in_word);
+}
+
+// ---- -j N:     ,      pread ----
+//
+//   ,     (in_word = 0).    
+//     ,      ,
+//             .
+
+typedef struct {
+    int fd;
+    off_t off, len;
+    Counts c;
+    int first_in_word; //    
+    int end_in_word;   //    
+    int err;           // errno  pread, 0   
+} Chunk;
+
+static void* count_chunk(void* arg)
+{
+    Chunk* k = arg;
+    unsigned char buf[BUF_SIZE];
+    off_t pos = k->off, end = k->off + k->len;
+    int in_word = 0;
+
+    while (pos < end) {
+        size_t want = end - pos < (off_t)sizeof buf ? (size_t)(end - pos) : sizeof buf;
+        ssize_t n = pread(k->fd, buf, want, pos);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0) {
+            k->err = errno;
+            break;
+        }
+        if (n == 0)
+            break; //    
+        if (pos == k->off)
+            k->first_in_word = !isspace(buf[0]);
+        k->c.bytes += (unsigned long long)n;
+        count_buf(buf, (size_t)n, &k->c, &in_word);
+        pos += n;
+    }
+    k->end_in_word = in_word;
+    return NULL;
+}
+
+//  FD     ; 0  , -1   
+//    ,   
+static int count_parallel(int fd, Counts* c, int jobs)
+{
+    Chunk k[MAX_JOBS];
+    pthread_t tid[MAX_JOBS];
+    int started[MAX_JOBS] = { 0 };
+    struct stat st;
+    off_t base, size, per;
+    int in_word, i;
+
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+        return -1;
+    base = lseek(fd, 0, SEEK_CUR);
+    if (base < 0 || base >= st.st_size)
+        return -1;
+    size = st.st_size - base;
+    if (size / MIN_CHUNK < jobs)
+        jobs = (int)(size / MIN_CHUNK);
+    if (jobs < 2)
+        return -1;
+
+    per = (size + jobs - 1) / jobs;
+    for (i = 0; i < jobs; i++) {
+        memset(&k[i], 0, sizeof k[i]);
+        k[i].fd = fd;
+        k[i].off = base + per * i;
+        k[i].len = size - per * i < per ? size - per * i : per;
+    }
+    //  0    ;       
+    for (i = 1; i < jobs; i++)
+        started[i] = pthread_create(&tid[i], NULL, count_chunk, &k[i]) == 0;
+    count_chunk(&k[0]);
+    for (i = 1; i < jobs; i++) {
+        if (started[i])
+            pthread_join(tid[i], NULL);
+        else
+            count_chunk(&k[i]);
+    }
+
+    for (i = 0; i < jobs; i++) {
+        if (k[i].err != 0) {
+            errno = k[i].err;
+            perror("pread");
+            exit(1);
+        }
+        c->bytes += k[i].c.bytes;
+        c->words += k[i].c.words;
+        c->lines += k[i].c.lines;
+        if (i > 0 && k[i - 1].end_in_word && k[i].first_in_word)
+            c->words--;
+    }
+
+    //   ,  ,     
+    in_word = k[jobs - 1].end_in_word;
+    if (lseek(fd, base + size, SEEK_SET) >= 0)
+        count_stream(fd, c, &in_word);
+    return 0;
+}
+
+// ---- --tee:     stdout,      ----
+//
+// tee(2)      ,   ;
+//          .  
+//  stdout     ,  
+//   ,     .  stdout  , 
+//       splice(2)  stdout;    splice
+// (   )   write    .
+
+enum tee_mode { TEE_DIRECT, TEE_VIA_PIPE, TEE_COPY };
+
+static void write_all(int fd, const unsigned char* p, size_t n)
+{
+    while (n > 0) {
+        ssize_t w = write(fd, p, n);
+        if (w < 0 && errno == EINTR)
+            continue;
+        if (w < 0) {
+            perror("write");
+            exit(1);
+        }
+        p += w;
+        n -= (size_t)w;
+    }
+}
+
+//   FD  N  (   tee)  
+static void count_exact(int fd, size_t n, unsigned char* buf, Counts* c, int* in_word)
+{
+    while (n > 0) {
+        ssize_t r = read(fd, buf, n < BUF_SIZE ? n : BUF_SIZE);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0) {
+            perror("read");
+            exit(1);
+        }
+        c->bytes += (unsigned long long)r;
+        count_buf(buf, (size_t)r, c, in_word);
+        n -= (size_t)r;
+    }
+}
+
+static void count_tee(int fd, Counts* c)
+{
+    unsigned char buf[BUF_SIZE];
+    struct stat in_st, out_st;
+    enum tee_mode mode = TEE_COPY;
+    int mid[2] = { -1, -1 };
+    int in_word = 0;
+
+    if (fstat(fd, &in_st) == 0 && S_ISFIFO(in_st.st_mode)) {
+        if (fstat(STDOUT_FILENO, &out_st) == 0 && S_ISFIFO(out_st.st_mode))
+            mode = TEE_DIRECT;
+        else if (pipe(mid) == 0)
+            mode = TEE_VIA_PIPE;
+    }
+
+    while (mode != TEE_COPY) {
+        int out = mode == TEE_DIRECT ? STDOUT_FILENO : mid[1];
+        ssize_t t = tee(fd, out, INT_MAX, 0);
+        if (t < 0 && errno == EINTR)
+            continue;
+        if (t < 0 && errno == EINVAL) {
+            mode = TEE_COPY;
+            break;
+        }
+        if (t < 0) {
+            perror("tee");
+            exit(1);
+        }
+        if (t == 0)
+            break; //  ,  
+        count_exact(fd, (size_t)t, buf, c, &in_word);
+        if (mode == TEE_VIA_PIPE) {
+            size_t left = (size_t)t;
+            while (left > 0) {
+                ssize_t s = splice(mid[0], NULL, STDOUT_FILENO, NULL, left, 0);
+                if (s < 0 && errno == EINTR)
+                    continue;
+                if (s < 0 && errno == EINVAL) {
+                    // stdout   splice: ,    mid,  write'
+                    while (left > 0) {
+                        ssize_t r = read(mid[0], buf, left < BUF_SIZE ? left : BUF_SIZE);
+                        if (r <= 0) {
+                            perror("read");
+                            exit(1);
+                        }
+                        write_all(STDOUT_FILENO, buf, (size_t)r);
+                        left -= (size_t)r;
+                    }
+                    mode = TEE_COPY;
+                    break;
+                }
+                if (s <= 0) {
+                    perror("splice");
+                    exit(1);
+                }
+                left -= (size_t)s;
+            }
+        }
+    }
+    if (mid[0] >= 0) {
+        close(mid[0]);
+        close(mid[1]);
+    }
+
+    //  : read, , write    ,   --tee   cat
+    for (;;) {
+        ssize_t n = read(fd, buf, sizeof buf);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0) {
+            perror("read");
+            exit(1);
+        }
+        if (n == 0)
+            break;
+        c->bytes += (unsigned long long)n;
+        count_buf(buf, (size_t)n, c, &in_word);
+        write_all(STDOUT_FILENO, buf, (size_t)n);
+    }
+}
+
+static void usage(const char* prog)
+{
+    fprintf(stderr, "usage: %s [-j N] [--tee] [--kernel=auto|avx512|avx2|sse2|scalar] [command [args...]]\n"
+                    "  -j N   count a regular file on stdin with N threads (pread per chunk);\n"
+                    "         not allowed with a command or --tee\n"
+                    "  --tee  pass the data on to stdout (tee/splice) and print the counts to stderr\n", prog);
+    exit(2);
+}
+
 int main(int argc, char* argv[])
 {
     Counts c = { 0, 0, 0 };
+    enum kernel_kind kernel = K_AUTO;
+    static const struct option longopts[] = {
+        { "kernel", required_argument, NULL, 'k' },
+        { "tee", no_argument, NULL, 't' },
+        { NULL, 0, NULL, 0 }
+    };
+    FILE* report = stdout;
+    int jobs = 1, tee_out = 0;
+    int opt;
+
+    // '+':      ,     
+    while ((opt = getopt_long(argc, argv, "+j:", longopts, NULL)) != -1) {
+        switch (opt) {
+        case 'j': {
+            char* end;
+            long v = strtol(optarg, &end, 10);
+            if (end == optarg || *end != '\0' || v < 1 || v > MAX_JOBS) {
+                fprintf(stderr, "invalid -j value '%s' (1..%d)\n", optarg, MAX_JOBS);
+                usage(argv[0]);
+            }
+            jobs = (int)v;
+            break;
+        }
+        case 't':
+            // stdout       stderr
+            tee_out = 1;
+            report = stderr;
+            break;
+        case 'k': {
+            int k;
+            for (k = K_AUTO; k <= K_SCALAR; k++)
+                if (strcmp(optarg, kernel_name[k]) == 0)
+                    break;
+            if (k > K_SCALAR)
+                usage(argv[0]);
+            kernel = (enum kernel_kind)k;
+            break;
+        }
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (kernel_init(kernel) != 0) {
+        fprintf(stderr, "kernel '%s' is not supported by this CPU\n", kernel_name[kernel]);
+        return 2;
+    }
+    //     --tee       -j  
+    if (jobs > 1 && (optind < argc || tee_out)) {
+        fprintf(stderr, "-j only applies to counting a file on stdin, not to a command or --tee\n");
+        usage(argv[0]);
+    }
+    argc -= optind - 1;
+    argv += optind - 1;
 
     if (argc == 1) {
-        count_fd(STDIN_FILENO, &c);
-        printf("%llu %llu %llu\n",
+        if (tee_out)
+            count_tee(STDIN_FILENO, &c);
+        else if (jobs < 2 || count_parallel(STDIN_FILENO, &c, jobs) != 0)
+            count_fd(STDIN_FILENO, &c);
+        fprintf(report, "%llu %llu %llu\n",
             (unsigned long long)c.bytes,
             (unsigned long long)c.words,
             (unsigned long long)c.lines);
@@ -92,7 +521,10 @@ int main(int argc, char* argv[])
             return 1;
         }
 
-        count_fd(pfd[0], &c);
+        if (tee_out)
+            count_tee(pfd[0], &c);
+        else
+            count_fd(pfd[0], &c);
 
         if (close(pfd[0]) == -1) {
             perror("close");
@@ -107,14 +539,14 @@ int main(int argc, char* argv[])
         //   ,    (   ).
         if (WIFEXITED(status) && WEXITSTATUS(status) != 0) {
             //    :
-            printf("%llu %llu %llu\n",
+            fprintf(report, "%llu %llu %llu\n",
                 (unsigned long long)c.bytes,
                 (unsigned long long)c.words,
                 (unsigned long long)c.lines);
             return WEXITSTATUS(status);
         }
 
-        printf("%llu %llu %llu\n",
+        fprintf(report, "%llu %llu %llu\n",
             (unsigned long long)c.bytes,
             (unsigned long long)c.words,
             (unsigned long long)c.lines);
@@ -0,0 +1,137 @@
+#!/usr/bin/env bash
+# bench_cp_mmap.sh — замеры для cp_mmap: параллельный memcpy, предзаполнение и THP,
+# сброс на диск по окнам (-F sync) против фоновой записи (-F async), каталог смешанных размеров,
+# матрица движков по размерам файла (медиана и разброс из RUNS прогонов)
+# Запуск: [RUNS=5] bash bench_cp_mmap.sh /path/to/cp_mmap [SIZE_MB]
+
+set -euo pipefail
+
+BIN_INPUT="${1:-./cp_mmap}"
+case "$BIN_INPUT" in
+  /*) BIN="$BIN_INPUT" ;;
+  *)  BIN="$(pwd)/$BIN_INPUT" ;;
+esac
+SIZE_MB="${2:-1024}"
+
+WORK="/tmp/cp_mmap_bench"
+rm -rf "$WORK" && mkdir -p "$WORK"
+cd "$WORK"
+# Калибровка --engine=auto — в свой кеш, чтобы не трогать пользовательский
+export XDG_CACHE_HOME="$WORK/cache"
+
+now(){ date +%s.%N; }
+# Сбросить page cache, чтобы прогоны были честными (нужен root; иначе — как есть)
+drop_caches(){ sync; echo 3 > /proc/sys/vm/drop_caches 2>/dev/null || true; }
+
+head -c $((SIZE_MB * 1024 * 1024)) /dev/urandom > src.bin
+
+# --- -j N: ускорение относительно однопоточного memcpy ---
+# cold — источник не в page cache (мажорные промахи), warm — уже в кеше (минорные)
+printf "\n== -j: %s MiB, ядер %s ==\n" "$SIZE_MB" "$(nproc)"
+printf "%-5s %4s %10s %10s %9s\n" "cache" "-j" "time, s" "MB/s" "speed-up"
+for cache in cold warm; do
+  base=""
+  for jobs in 1 2 4 8; do
+    rm -f dst.bin
+    if [ "$cache" = cold ]; then drop_caches; else cat src.bin > /dev/null; sync; fi
+    t0=$(now)
+    "$BIN" -e mmap -j "$jobs" src.bin dst.bin
+    t1=$(now)
+    cmp -s src.bin dst.bin || { echo "MISMATCH: -j $jobs" >&2; exit 1; }
+    t=$(awk "BEGIN{print $t1 - $t0}")
+    [ -n "$base" ] || base=$t
+    printf "%-5s %4s %10.3f %10.1f %8.2fx\n" "$cache" "$jobs" "$t" \
+      "$(awk "BEGIN{print $SIZE_MB / $t}")" "$(awk "BEGIN{print $base / $t}")"
+  done
+done
+
+# --- -P/-H: сколько промахов снимает предзаполнение и огромные страницы (-b, холодный кеш) ---
+printf "\n== prefault/THP: промахи getrusage, всего и внутри memcpy ==\n"
+printf "%-9s %-4s %8s %9s %9s %9s %9s %9s\n" \
+  "-P" "-H" "time, s" "MB/s" "minflt" "majflt" "cp.min" "cp.maj"
+for pf in none populate willneed; do
+  for huge in "" "-H"; do
+    rm -f dst.bin
+    drop_caches
+    # shellcheck disable=SC2086
+    out=$("$BIN" -e mmap -b -P "$pf" $huge src.bin dst.bin 2>&1)
+    cmp -s src.bin dst.bin || { echo "MISMATCH: -P $pf $huge" >&2; exit 1; }
+    # shellcheck disable=SC2046
+    printf "%-9s %-4s %8s %9s %9s %9s %9s %9s\n" "$pf" "${huge:--}" $(printf '%s\n' "$out" | sed -n \
+      's/.*, \([0-9.]*\) s, \([0-9.]*\) MB\/s, faults minor \([0-9]*\) major \([0-9]*\), in memcpy minor \([0-9]*\) major \([0-9]*\).*/\1 \2 \3 \4 \5 \6/p')
+  done
+done
+
+# --- -F: ожидание диска на каждом окне против фоновой записи с одним fsync в конце ---
+printf "\n== flush: общее время и время ожидания диска (3 прогона) ==\n"
+printf "%-6s %4s %8s %9s %9s\n" "-F" "run" "time, s" "MB/s" "flush, s"
+for fl in sync async; do
+  for run in 1 2 3; do
+    rm -f dst.bin
+    drop_caches
+    out=$("$BIN" -e mmap -b -F "$fl" src.bin dst.bin 2>&1)
+    cmp -s src.bin dst.bin || { echo "MISMATCH: -F $fl" >&2; exit 1; }
+    # shellcheck disable=SC2046
+    printf "%-6s %4s %8s %9s %9s\n" "$fl" "$run" $(printf '%s\n' "$out" | sed -n \
+      's/.*, \([0-9.]*\) s, \([0-9.]*\) MB\/s, .*flush \([0-9.]*\) s.*/\1 \2 \3/p')
+  done
+done
+
+# --- каталог: процесс на файл против одного запуска (арена для мелких, окна для крупных) ---
+# 2000 файлов по 1 КиБ, 100 — от 1 КиБ до 4 МиБ
+mkdir -p tree
+head -c $((2000 * 1024)) /dev/urandom > blob && (cd tree && split -b 1K -a 4 ../blob t_) && rm blob
+for i in $(seq 1 100); do
+  head -c $(( (RANDOM * 32768 + RANDOM) % (4 * 1024 * 1024) + 1024 )) /dev/urandom > "tree/m_$i"
+done
+printf "\n== каталог: %s файлов, %s байт ==\n" "$(find tree -type f | wc -l)" "$(du -sb tree | cut -f1)"
+printf "%-24s %8s %10s\n" "mode" "time, s" "files/s"
+for mode in per-file "dir -F sync" "dir -F async"; do
+  rm -rf out && mkdir out
+  drop_caches
+  t0=$(now)
+  case "$mode" in
+    per-file) for f in tree/*; do "$BIN" "$f" "out/${f##*/}"; done ;;
+    # shellcheck disable=SC2086
+    *)        "$BIN" ${mode#dir } tree/* out ;;
+  esac
+  t1=$(now)
+  diff -r tree out >/dev/null || { echo "MISMATCH: $mode" >&2; exit 1; }
+  n=$(find tree -type f | wc -l)
+  printf "%-24s %8.3f %10.0f\n" "$mode" "$(awk "BEGIN{print $t1 - $t0}")" "$(awk "BEGIN{print $n / ($t1 - $t0)}")"
+done
+
+# --- движки × размер файла: тёплый кеш, без ожидания диска (-F async, как при калибровке) ---
+# На каждый размер — столько файлов, чтобы вышло ~256 МиБ (не больше 4000 штук).
+# Каждая ячейка — RUNS прогонов (по умолчанию 5), движки чередуются внутри прогона;
+# печатается медиана и разброс min–max. mmap и auto до 256 КиБ идут тем же путём, что rw
+# (арена), — разница между ними в этих строках и есть шум замера.
+RUNS="${RUNS:-5}"
+# медиана и min-max по строке чисел
+stats(){ tr ' ' '\n' | grep . | sort -g | awk '{v[NR]=$1} END{m=NR%2 ? v[(NR+1)/2] : (v[NR/2]+v[NR/2+1])/2;
+  printf "%.0f (%.0f-%.0f)", m, v[1], v[NR]}'; }
+printf "\n== engines: MB/s по размеру файла (%s), медиана (min-max) из %s ==\n" "$(stat -f -c %T .)" "$RUNS"
+printf "%-6s %5s %16s %16s %16s %16s\n" "size" "files" "mmap" "cfr" "rw" "auto"
+for size in 4K 64K 256K 1M 4M 16M 64M 256M; do
+  bytes=$(numfmt --from=iec "$size")
+  n=$(( 256 * 1024 * 1024 / bytes )); [ "$n" -le 4000 ] || n=4000
+  rm -rf mx && mkdir -p mx/in
+  head -c "$bytes" /dev/urandom > mx/one
+  for i in $(seq 1 "$n"); do cp mx/one "mx/in/f_$i"; done
+  cat mx/in/* > /dev/null
+  declare -A res=()
+  for run in $(seq 1 "$RUNS"); do
+    for eng in mmap cfr rw auto; do
+      rm -rf mx/out && mkdir mx/out && sync
+      out=$("$BIN" -b -F async -e "$eng" mx/in/* mx/out 2>&1)
+      res[$eng]="${res[$eng]:-} $(printf '%s\n' "$out" | sed -n 's/.*, \([0-9.]*\) MB\/s, faults.*/\1/p')"
+    done
+  done
+  printf "%-6s %5s" "$size" "$n"
+  for eng in mmap cfr rw auto; do printf " %16s" "$(printf '%s' "${res[$eng]}" | stats)"; done
+  printf "\n"
+  unset res
+done
+printf "калибровка: %s\n" "$(cat "$XDG_CACHE_HOME/cp_mmap.calib" 2>/dev/null)"
+
+rm -rf "$WORK"
@@ -1,116 +1,775 @@
 #define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
+#define _FILE_OFFSET_BITS 64
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <stdint.h>
 #include <fcntl.h>
+#include <getopt.h>
+#include <libgen.h>
+#include <limits.h>
+#include <pthread.h>
 #include <sys/mman.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
+#include <sys/vfs.h>
+#include <time.h>
 #include <unistd.h>
 
+#define DEFAULT_WINDOW ((size_t)64 << 20)
+#define MAX_JOBS 64
+#define HUGE_PAGE ((size_t)2 << 20)
+#define SMALL_MAX ((size_t)256 << 10) // файлы до этого размера идут через арену
+#define CALIB_SIZE ((size_t)32 << 20)  // объём пробного копирования для --engine=auto
+#define CFR_CHUNK ((size_t)64 << 20)   // шаг copy_file_range, если окна нет (-w 0)
+
+// Сетевые и FUSE-ФС (statfs.f_type): mmap на них платит за каждый промах
+// запросом к серверу или демону, а copy_file_range может скопировать на стороне сервера
+#define NFS_MAGIC   0x6969
+#define SMB_MAGIC   0x517B
+#define CIFS_MAGIC  0xFF534D42
+#define SMB2_MAGIC  0xFE534D42
+#define FUSE_MAGIC  0x65735546
+#define CEPH_MAGIC  0x00C36400
+#define V9FS_MAGIC  0x01021997
+#define AFS_MAGIC   0x5346414F
+
+enum prefault { PF_NONE, PF_POPULATE, PF_WILLNEED };
+enum flush { FL_SYNC, FL_ASYNC, FL_NONE }; // FL_NONE — только для калибровки
+enum engine { EN_AUTO, EN_MMAP, EN_CFR, EN_RW, EN_COUNT };
+
+static const char* const engine_name[EN_COUNT] = { "auto", "mmap", "cfr", "rw" };
+
+struct copy_opts {
+    size_t page;
+    size_t window;
+    int jobs;
+    enum prefault prefault;
+    int huge;
+    int huge_failed; // MADV_HUGEPAGE отвергнут: предупредить один раз
+    enum flush flush;
+    int bench;
+    long copy_minflt, copy_majflt; // промахи внутри memcpy, без mmap/populate
+    double flush_sec;              // сколько ждали диск: msync/sync_file_range/fsync
+    char* arena;                   // SMALL_MAX байт, отображается один раз на весь запуск
+    int defer_sync;                // -F async с несколькими файлами: один syncfs в конце
+    long long files, bytes;
+    enum engine engine;
+    long long by_engine[EN_COUNT];
+    long calib_fs;                 // ФС приёмника, для которой выбран calib_engine
+    enum engine calib_engine;      // EN_AUTO — ещё не выбирали
+};
+
 static void die(const char* where)
 {
     perror(where);
     exit(EXIT_FAILURE);
 }
 
-int main(int argc, char** argv)
+static void usage(const char* prog)
+{
+    fprintf(stderr, "usage: %s [-w SIZE[K|M|G]] [-j N] [-P none|populate|willneed] [-H] [-F sync|async] [-b]\n"
+                    "          [-e auto|mmap|cfr|rw] <from> <to> | <from>... <dir>\n"
+                    "  -w  mapping window, default 64M; 0 maps the whole file at once\n"
+                    "      (cfr/rw: copy_file_range step and -F async writeback step, 0 means 64M)\n"
+                    "  -j  copy each window with N threads, default 1\n"
+                    "  -P  prefault windows before memcpy: MAP_POPULATE or MADV_WILLNEED\n"
+                    "  -H  ask for transparent huge pages on the mappings\n"
+                    "  -F  flush mode: sync waits for every window (default), async only starts\n"
+                    "      writeback per window and waits once at the end\n"
+                    "  -b  report time, flush time and page faults (getrusage) to stderr\n"
+                    "  -e, --engine=auto|mmap|cfr|rw\n"
+                    "      mmap (default): windows as above, files up to 256K through read/write\n"
+                    "      auto: small files rw, network/FUSE cfr, the rest by a one-time\n"
+                    "      calibration cached in $XDG_CACHE_HOME/cp_mmap.calib\n"
+                    "      -j, -P and -H only affect files copied with mmap\n", prog);
+    exit(EXIT_FAILURE);
+}
+
+// Размер с необязательным суффиксом K/M/G (степени 1024)
+static int parse_size(const char* s, size_t* out)
+{
+    char* end;
+    unsigned long long v;
+    int shift = 0;
+
+    errno = 0;
+    v = strtoull(s, &end, 10);
+    if (errno != 0 || end == s)
+        return -1;
+    switch (*end) {
+    case 'K': case 'k': shift = 10; end++; break;
+    case 'M': case 'm': shift = 20; end++; break;
+    case 'G': case 'g': shift = 30; end++; break;
+    }
+    if (*end != '\0' || v > (unsigned long long)SIZE_MAX >> shift)
+        return -1;
+    *out = (size_t)(v << shift);
+    return 0;
+}
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+struct stripe {
+    char* dst;
+    const char* src;
+    size_t n;
+};
+
+static void* stripe_copy(void* arg)
+{
+    struct stripe* s = arg;
+    memcpy(s->dst, s->src, s->n);
+    return NULL;
+}
+
+// Окно режется на полосы по границам страниц, по одной на поток: страничные
+// промахи и сам memcpy идут параллельно. Первую полосу копирует вызывающий поток;
+// если поток не создался — его полосу тоже.
+static void parallel_copy(char* dst, const char* src, size_t n, int jobs, size_t page)
+{
+    struct stripe s[MAX_JOBS];
+    pthread_t tid[MAX_JOBS];
+    int started[MAX_JOBS] = { 0 };
+    size_t per, off = 0;
+    int i, k = 0;
+
+    per = (n + (size_t)jobs - 1) / (size_t)jobs;
+    per = (per + page - 1) / page * page;
+    if (jobs <= 1 || per >= n) {
+        memcpy(dst, src, n);
+        return;
+    }
+
+    for (i = 0; i < jobs && off < n; i++, off += per) {
+        s[i].dst = dst + off;
+        s[i].src = src + off;
+        s[i].n = n - off < per ? n - off : per;
+        k++;
+    }
+    for (i = 1; i < k; i++)
+        started[i] = pthread_create(&tid[i], NULL, stripe_copy, &s[i]) == 0;
+    stripe_copy(&s[0]);
+    for (i = 1; i < k; i++) {
+        if (started[i])
+            pthread_join(tid[i], NULL);
+        else
+            stripe_copy(&s[i]);
+    }
+}
+
+// Запросить THP на отображении. Для файловых отображений это работает не везде
+// (tmpfs, ФС с большими фолиантами), поэтому отказ не ошибка — копируем 4K-страницами.
+static void want_huge(void* map, size_t n, struct copy_opts* o)
+{
+    if (madvise(map, n, MADV_HUGEPAGE) != 0 && !o->huge_failed) {
+        o->huge_failed = 1;
+        fprintf(stderr, "cp_mmap: huge pages unavailable (%s), using base pages\n", strerror(errno));
+    }
+}
+
+// MAP_POPULATE срабатывает внутри mmap, то есть раньше MADV_HUGEPAGE; с -H
+// отображаем без него и дозаполняем через MADV_POPULATE_*, когда он есть.
+// Для DEST MAP_POPULATE мало: общие страницы заводятся только на чтение и memcpy
+// всё равно ловит промах на первой записи — нужен MADV_POPULATE_WRITE.
+static void populate(void* map, size_t n, int write)
+{
+#ifdef MADV_POPULATE_READ
+    (void)madvise(map, n, write ? MADV_POPULATE_WRITE : MADV_POPULATE_READ);
+#else
+    (void)map;
+    (void)n;
+    (void)write;
+#endif
+}
+
+// Одно окно [off, off + n): отобразить, скопировать, сбросить на диск и отпустить.
+// В памяти одновременно живёт не больше одного окна SRC и одного окна DEST.
+static int copy_window(int fd_src, int fd_dst, off_t off, size_t n, struct copy_opts* o,
+                       const char** where)
 {
-    const char* src_path, * dst_path;
-    int fd_src, fd_dst;
-    struct stat st;
-    size_t len;
     void* src_map, * dst_map;
+    double t0;
+    int src_flags = o->prefault == PF_POPULATE && !o->huge ? MAP_POPULATE : 0;
+#ifdef MADV_POPULATE_WRITE
+    int dst_flags = 0;
+#else
+    int dst_flags = src_flags;
+#endif
+    int rc = 0;
 
-    if (argc != 3) {
-        fprintf(stderr, "usage: %s <from> <to>\n", argv[0]);
-        return EXIT_FAILURE;
+    src_map = mmap(NULL, n, PROT_READ, MAP_PRIVATE | src_flags, fd_src, off);
+    if (src_map == MAP_FAILED) {
+        *where = "mmap(src)";
+        return -1;
+    }
+    dst_map = mmap(NULL, n, PROT_WRITE, MAP_SHARED | dst_flags, fd_dst, off);
+    if (dst_map == MAP_FAILED) {
+        munmap(src_map, n);
+        *where = "mmap(dst)";
+        return -1;
+    }
+    if (o->huge) {
+        want_huge(src_map, n, o);
+        want_huge(dst_map, n, o);
+    }
+    (void)madvise(src_map, n, MADV_SEQUENTIAL);
+    (void)madvise(dst_map, n, MADV_SEQUENTIAL);
+    if (o->prefault == PF_WILLNEED) {
+        (void)madvise(src_map, n, MADV_WILLNEED);
+        (void)madvise(dst_map, n, MADV_WILLNEED);
+    } else if (o->prefault == PF_POPULATE) {
+        if (o->huge)
+            populate(src_map, n, 0);
+        populate(dst_map, n, 1);
+    }
+
+    if (o->bench) {
+        struct rusage r0, r1;
+        getrusage(RUSAGE_SELF, &r0);
+        parallel_copy(dst_map, src_map, n, o->jobs, o->page);
+        getrusage(RUSAGE_SELF, &r1);
+        o->copy_minflt += r1.ru_minflt - r0.ru_minflt;
+        o->copy_majflt += r1.ru_majflt - r0.ru_majflt;
+    } else {
+        parallel_copy(dst_map, src_map, n, o->jobs, o->page);
     }
 
-    src_path = argv[1];
-    dst_path = argv[2];
+    t0 = o->bench ? now_sec() : 0;
+    if (o->flush == FL_SYNC) {
+        if (msync(dst_map, n, MS_SYNC) != 0) {
+            *where = "msync(dst)";
+            rc = -1;
+        }
+    } else if (o->flush == FL_ASYNC &&
+               sync_file_range(fd_dst, off, (off_t)n, SYNC_FILE_RANGE_WRITE) != 0) {
+        // Запустить запись окна и не ждать: диск пишет, пока копируются следующие окна.
+        // Ошибки записи всплывут в итоговом fsync. Без sync_file_range — MS_ASYNC.
+        if (msync(dst_map, n, MS_ASYNC) != 0) {
+            *where = "msync(dst)";
+            rc = -1;
+        }
+    }
+    if (o->bench)
+        o->flush_sec += now_sec() - t0;
+    // Готовое окно больше не нужно: страницы уходят из RSS сразу, не дожидаясь munmap
+    (void)madvise(src_map, n, MADV_DONTNEED);
+    if (rc == 0)
+        (void)madvise(dst_map, n, MADV_DONTNEED);
 
-    fd_src = open(src_path, O_RDONLY);
-    if (fd_src < 0)
-        die("open(src)");
+    if (munmap(src_map, n) != 0 && rc == 0) {
+        *where = "munmap(src)";
+        rc = -1;
+    }
+    if (munmap(dst_map, n) != 0 && rc == 0) {
+        *where = "munmap(dst)";
+        rc = -1;
+    }
+    return rc;
+}
+
+// Запустить запись готового куска при -F async; ждать будет итоговый fsync/syncfs
+static void start_writeback(int fd_dst, off_t off, off_t len, const struct copy_opts* o)
+{
+    if (o->flush == FL_ASYNC && len > 0)
+        (void)sync_file_range(fd_dst, off, len, SYNC_FILE_RANGE_WRITE);
+}
+
+// read в арену и write из неё. Арена отображается один раз на весь запуск, так что
+// мелкий файл не платит ни за mmap/munmap, ни за промахи — на каталоге из тысяч мелких
+// файлов именно установка отображений и стоит дороже всего. SIZE > 0 — размер из fstat:
+// дочитав до него, лишний read ради EOF не делаем.
+static int copy_rw(int fd_src, int fd_dst, off_t size, struct copy_opts* o, const char** where)
+{
+    size_t chunk = o->window ? o->window : CFR_CHUNK;
+    off_t done = 0, started = 0;
+
+    if (o->arena == NULL) {
+        void* a = mmap(NULL, SMALL_MAX, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+        if (a == MAP_FAILED) {
+            *where = "mmap(arena)";
+            return -1;
+        }
+        o->arena = a;
+    }
+    for (;;) {
+        ssize_t r = read(fd_src, o->arena, SMALL_MAX);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r < 0) {
+            *where = "read(src)";
+            return -1;
+        }
+        if (r == 0)
+            break;
+        for (ssize_t w = 0; w < r;) {
+            ssize_t k = write(fd_dst, o->arena + w, (size_t)(r - w));
+            if (k < 0 && errno == EINTR)
+                continue;
+            if (k < 0) {
+                *where = "write(dst)";
+                return -1;
+            }
+            w += k;
+        }
+        done += r;
+        if (done - started >= (off_t)chunk) {
+            start_writeback(fd_dst, started, done - started, o);
+            started = done;
+        }
+        if (size > 0 && done >= size)
+            break;
+    }
+    start_writeback(fd_dst, started, done - started, o);
+    o->bytes += done;
+    return 0;
+}
+
+// copy_file_range: данные не выходят в пространство пользователя, а на NFS 4.2/SMB
+// копирование может случиться на сервере. Если ядро или ФС не умеют (или это не
+// обычные файлы) — и ничего ещё не скопировано, — переходим на read/write.
+static int copy_cfr(int fd_src, int fd_dst, off_t size, struct copy_opts* o, const char** where)
+{
+    size_t chunk = o->window ? o->window : CFR_CHUNK;
+    off_t done = 0, started = 0;
+
+    for (;;) {
+        ssize_t r = copy_file_range(fd_src, NULL, fd_dst, NULL, chunk, 0);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r < 0 && done == 0 && (errno == EXDEV || errno == ENOSYS || errno == EOPNOTSUPP ||
+                                   errno == EINVAL || errno == EBADF))
+            return copy_rw(fd_src, fd_dst, size, o, where);
+        if (r < 0) {
+            *where = "copy_file_range";
+            return -1;
+        }
+        if (r == 0)
+            break;
+        done += r;
+        start_writeback(fd_dst, started, done - started, o);
+        started = done;
+        if (size > 0 && done >= size)
+            break;
+    }
+    o->bytes += done;
+    return 0;
+}
+
+static int copy_mmap(int fd_src, int fd_dst, off_t size, struct copy_opts* o, const char** where)
+{
+    size_t window = o->window;
+    off_t off;
+
+    if (ftruncate(fd_dst, size) != 0) {
+        *where = "ftruncate(dst)";
+        return -1;
+    }
+    if (window == 0 || (off_t)window > size)
+        window = (size_t)size;
+
+    for (off = 0; off < size; off += (off_t)window) {
+        size_t n = size - off < (off_t)window ? (size_t)(size - off) : window;
+        if (copy_window(fd_src, fd_dst, off, n, o, where) != 0)
+            return -1;
+    }
+    o->bytes += size;
+    return 0;
+}
+
+static int is_remote_fs(int fd)
+{
+    struct statfs sf;
+    if (fstatfs(fd, &sf) != 0)
+        return 0;
+    switch ((unsigned long)sf.f_type) {
+    case NFS_MAGIC: case SMB_MAGIC: case CIFS_MAGIC: case SMB2_MAGIC:
+    case FUSE_MAGIC: case CEPH_MAGIC: case V9FS_MAGIC: case AFS_MAGIC:
+        return 1;
+    }
+    return 0;
+}
+
+static void calib_path(char* buf, size_t size)
+{
+    const char* xdg = getenv("XDG_CACHE_HOME");
+    const char* home = getenv("HOME");
+
+    if (xdg != NULL && *xdg != '\0')
+        snprintf(buf, size, "%s/cp_mmap.calib", xdg);
+    else if (home != NULL && *home != '\0')
+        snprintf(buf, size, "%s/.cache/cp_mmap.calib", home);
+    else
+        buf[0] = '\0';
+}
+
+// Кеш: строка на ФС — "f_type движок MB/s(mmap) MB/s(cfr) MB/s(rw)"
+static enum engine calib_load(long fs)
+{
+    char path[PATH_MAX], name[16];
+    long type;
+    FILE* f;
+    enum engine e = EN_AUTO;
 
+    calib_path(path, sizeof(path));
+    if (path[0] == '\0' || (f = fopen(path, "r")) == NULL)
+        return EN_AUTO;
+    while (fscanf(f, "%lx %15s %*f %*f %*f", &type, name) == 2) {
+        if (type != fs)
+            continue;
+        for (int k = EN_MMAP; k < EN_COUNT; k++)
+            if (strcmp(name, engine_name[k]) == 0)
+                e = (enum engine)k;
+    }
+    fclose(f);
+    return e;
+}
+
+static void calib_store(long fs, enum engine e, const double mbps[EN_COUNT])
+{
+    char path[PATH_MAX];
+    FILE* f;
+
+    calib_path(path, sizeof(path));
+    if (path[0] == '\0')
+        return;
+    f = fopen(path, "a");
+    if (f == NULL && errno == ENOENT) {
+        char dir[PATH_MAX];
+        snprintf(dir, sizeof(dir), "%s", path);
+        (void)mkdir(dirname(dir), 0700);
+        f = fopen(path, "a");
+    }
+    if (f == NULL)
+        return;
+    fprintf(f, "%lx %s %.0f %.0f %.0f\n", fs, engine_name[e], mbps[EN_MMAP], mbps[EN_CFR], mbps[EN_RW]);
+    fclose(f);
+}
+
+// Пробный прогон: CALIB_SIZE байт каждым движком между двумя безымянными файлами
+// (O_TMPFILE) в каталоге приёмника, лучшее из двух по времени; диск не ждём — сравниваем
+// сами пути копирования. Не вышло (нет O_TMPFILE, нет места) — EN_MMAP.
+static enum engine calibrate(const char* dir, long fs, struct copy_opts* o)
+{
+    struct copy_opts c = *o;
+    double mbps[EN_COUNT] = { 0 };
+    enum engine best = EN_MMAP;
+    const char* where;
+    int a, b;
+
+    a = open(dir, O_TMPFILE | O_RDWR, 0600);
+    b = open(dir, O_TMPFILE | O_RDWR, 0600);
+    if (a < 0 || b < 0 || ftruncate(a, (off_t)CALIB_SIZE) != 0)
+        goto out;
+    c.flush = FL_NONE;
+    c.bench = 0;
+    c.jobs = 1;
+    // Заполнить источник ненулевыми данными, чтобы не копировать дыры
+    {
+        char* m = mmap(NULL, CALIB_SIZE, PROT_WRITE, MAP_SHARED, a, 0);
+        if (m == MAP_FAILED)
+            goto out;
+        memset(m, 0x5a, CALIB_SIZE);
+        munmap(m, CALIB_SIZE);
+    }
+    for (int e = EN_MMAP; e < EN_COUNT; e++) {
+        double t_best = 0;
+        for (int run = 0; run < 2; run++) {
+            double t;
+            if (lseek(a, 0, SEEK_SET) != 0 || ftruncate(b, 0) != 0 || lseek(b, 0, SEEK_SET) != 0)
+                goto out;
+            t = now_sec();
+            if ((e == EN_MMAP ? copy_mmap(a, b, (off_t)CALIB_SIZE, &c, &where) :
+                 e == EN_CFR ? copy_cfr(a, b, (off_t)CALIB_SIZE, &c, &where) :
+                 copy_rw(a, b, (off_t)CALIB_SIZE, &c, &where)) != 0)
+                goto out;
+            t = now_sec() - t;
+            if (run == 0 || t < t_best)
+                t_best = t;
+        }
+        mbps[e] = t_best > 0 ? (double)CALIB_SIZE / 1e6 / t_best : 0;
+        if (mbps[e] > mbps[best])
+            best = (enum engine)e;
+    }
+    calib_store(fs, best, mbps);
+out:
+    o->arena = c.arena; // арену могла завести copy_rw — не терять
+    if (a >= 0)
+        close(a);
+    if (b >= 0)
+        close(b);
+    return best;
+}
+
+// Движок для одного файла. mmap (по умолчанию): мелкие и не обычные — через арену,
+// остальные — окнами; cfr и rw применяются ко всем файлам; auto: мелкие — через арену,
+// сетевые и FUSE — cfr, остальные — победитель калибровки для ФС приёмника.
+static enum engine pick_engine(int fd_src, int fd_dst, const struct stat* st, const char* dst_path,
+                               struct copy_opts* o)
+{
+    struct statfs sf;
+    char dir[PATH_MAX];
+
+    if (o->engine == EN_CFR || o->engine == EN_RW)
+        return o->engine;
+    if (!S_ISREG(st->st_mode) || (size_t)st->st_size <= SMALL_MAX)
+        return EN_RW;
+    if (o->engine == EN_MMAP)
+        return EN_MMAP;
+    if (is_remote_fs(fd_src) || is_remote_fs(fd_dst))
+        return EN_CFR;
+    if (fstatfs(fd_dst, &sf) != 0)
+        return EN_MMAP;
+    if (o->calib_engine == EN_AUTO || o->calib_fs != (long)sf.f_type) {
+        o->calib_fs = (long)sf.f_type;
+        o->calib_engine = calib_load(o->calib_fs);
+        if (o->calib_engine == EN_AUTO) {
+            snprintf(dir, sizeof(dir), "%s", dst_path);
+            o->calib_engine = calibrate(dirname(dir), o->calib_fs, o);
+        }
+    }
+    return o->calib_engine;
+}
+
+// Один файл SRC -> DST. Ошибка возвращается как -1 с errno и *where, без выхода:
+// при копировании в каталог остальные файлы всё равно копируются.
+static int copy_file(const char* src_path, const char* dst_path, struct copy_opts* o,
+                     const char** where)
+{
+    int fd_src, fd_dst, rc, saved;
+    struct stat st;
+    enum engine e;
+    off_t size;
+    double t1;
+
+    fd_src = open(src_path, O_RDONLY);
+    if (fd_src < 0) {
+        *where = "open(src)";
+        return -1;
+    }
     if (fstat(fd_src, &st) != 0) {
-        close(fd_src);
-        die("fstat(src)");
+        *where = "fstat(src)";
+        goto fail_src;
+    }
+    if (S_ISDIR(st.st_mode)) {
+        errno = EISDIR;
+        *where = "open(src)";
+        goto fail_src;
     }
 
     fd_dst = open(dst_path, O_CREAT | O_RDWR | O_TRUNC, 0644);
     if (fd_dst < 0) {
-        close(fd_src);
-        die("open(dst)");
+        *where = "open(dst)";
+        goto fail_src;
     }
 
-    if (ftruncate(fd_dst, st.st_size) != 0) {
-        close(fd_src);
-        close(fd_dst);
-        die("ftruncate(dst)");
-    }
+    e = pick_engine(fd_src, fd_dst, &st, dst_path, o);
+    size = S_ISREG(st.st_mode) ? st.st_size : 0;
+    if (e == EN_MMAP)
+        rc = copy_mmap(fd_src, fd_dst, size, o, where);
+    else if (e == EN_CFR)
+        rc = copy_cfr(fd_src, fd_dst, size, o, where);
+    else
+        rc = copy_rw(fd_src, fd_dst, size, o, where);
+    if (rc != 0)
+        goto fail_both;
 
-    if (st.st_size == 0) {
+    if (close(fd_src) != 0) {
+        *where = "close(src)";
+        fd_src = -1;
+        goto fail_both;
+    }
+    fd_src = -1;
+    if (!o->defer_sync) {
+        t1 = o->bench ? now_sec() : 0;
         if (fsync(fd_dst) != 0) {
-            close(fd_src);
-            close(fd_dst);
-            die("fsync(dst)");
+            *where = "fsync(dst)";
+            goto fail_both;
         }
-        if (close(fd_src) != 0)
-            die("close(src)");
-        if (close(fd_dst) != 0)
-            die("close(dst)");
-        return EXIT_SUCCESS;
+        if (o->bench)
+            o->flush_sec += now_sec() - t1;
     }
-
-    len = (size_t)st.st_size;
-
-    src_map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd_src, 0);
-    if (src_map == MAP_FAILED) {
-        close(fd_src);
-        close(fd_dst);
-        die("mmap(src)");
+    if (close(fd_dst) != 0) {
+        *where = "close(dst)";
+        return -1;
     }
+    o->files++;
+    o->by_engine[e]++;
+    return 0;
 
-    dst_map = mmap(NULL, len, PROT_WRITE, MAP_SHARED, fd_dst, 0);
-    if (dst_map == MAP_FAILED) {
-        munmap(src_map, len);
+fail_both:
+    saved = errno;
+    close(fd_dst);
+    errno = saved;
+fail_src:
+    saved = errno;
+    if (fd_src >= 0)
         close(fd_src);
-        close(fd_dst);
-        die("mmap(dst)");
+    errno = saved;
+    return -1;
+}
+
+int main(int argc, char** argv)
+{
+    const char* target;
+    const char* where;
+    char path[PATH_MAX];
+    size_t align;
+    struct copy_opts o = { 0, DEFAULT_WINDOW, 1, PF_NONE, 0, 0, FL_SYNC, 0, 0, 0, 0, NULL, 0, 0, 0,
+                          EN_MMAP, { 0 }, 0, EN_AUTO };
+    static const struct option longopts[] = {
+        { "engine", required_argument, NULL, 'e' },
+        { NULL, 0, NULL, 0 }
+    };
+    struct rusage ru0, ru1;
+    struct stat tst;
+    double t0 = 0, t1;
+    int nsrc, to_dir, i, status = EXIT_SUCCESS;
+    int mmap_opts = 0; // заданы -j/-P/-H
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "w:j:P:HF:be:", longopts, NULL)) != -1) {
+        switch (opt) {
+        case 'w':
+            if (parse_size(optarg, &o.window) != 0) {
+                fprintf(stderr, "invalid window size '%s'\n", optarg);
+                usage(argv[0]);
+            }
+            break;
+        case 'j': {
+            char* end;
+            long v = strtol(optarg, &end, 10);
+            mmap_opts = 1;
+            if (end == optarg || *end != '\0' || v < 1 || v > MAX_JOBS) {
+                fprintf(stderr, "invalid -j value '%s' (1..%d)\n", optarg, MAX_JOBS);
+                usage(argv[0]);
+            }
+            o.jobs = (int)v;
+            break;
+        }
+        case 'P':
+            mmap_opts = 1;
+            if (strcmp(optarg, "none") == 0)
+                o.prefault = PF_NONE;
+            else if (strcmp(optarg, "populate") == 0)
+                o.prefault = PF_POPULATE;
+            else if (strcmp(optarg, "willneed") == 0)
+                o.prefault = PF_WILLNEED;
+            else
+                usage(argv[0]);
+            break;
+        case 'H':
+            mmap_opts = 1;
+            o.huge = 1;
+            break;
+        case 'F':
+            if (strcmp(optarg, "sync") == 0)
+                o.flush = FL_SYNC;
+            else if (strcmp(optarg, "async") == 0)
+                o.flush = FL_ASYNC;
+            else
+                usage(argv[0]);
+            break;
+        case 'b':
+            o.bench = 1;
+            break;
+        case 'e':
+            for (i = EN_AUTO; i < EN_COUNT; i++)
+                if (strcmp(optarg, engine_name[i]) == 0)
+                    break;
+            if (i == EN_COUNT)
+                usage(argv[0]);
+            o.engine = (enum engine)i;
+            break;
+        default:
+            usage(argv[0]);
+        }
     }
+    nsrc = argc - optind - 1;
+    if (nsrc < 1)
+        usage(argv[0]);
+    if (mmap_opts && o.engine != EN_MMAP)
+        fprintf(stderr, "warning: -j, -P and -H only affect files copied with mmap, engine is %s\n",
+                engine_name[o.engine]);
+    target = argv[argc - 1];
+    to_dir = stat(target, &tst) == 0 && S_ISDIR(tst.st_mode);
+    if (nsrc > 1 && !to_dir) {
+        fprintf(stderr, "target '%s' is not a directory\n", target);
+        return EXIT_FAILURE;
+    }
+    // С -F async и каталогом fsync по файлам не нужен: запись запущена на каждом,
+    // а дождаться всех разом можно одним syncfs в конце
+    o.defer_sync = o.flush == FL_ASYNC && to_dir;
 
-    memcpy(dst_map, src_map, len);
+    // Смещение mmap обязано быть кратно странице — окно тоже; с -H кратно
+    // огромной странице, иначе окна не лягут на границы PMD
+    o.page = (size_t)sysconf(_SC_PAGESIZE);
+    align = o.huge ? HUGE_PAGE : o.page;
+    o.window = (o.window + align - 1) / align * align;
 
-    if (msync(dst_map, len, MS_SYNC) != 0) {
-        munmap(src_map, len);
-        munmap(dst_map, len);
-        close(fd_src);
-        close(fd_dst);
-        die("msync(dst)");
+    if (o.bench) {
+        getrusage(RUSAGE_SELF, &ru0);
+        t0 = now_sec();
     }
 
-    if (munmap(src_map, len) != 0) {
-        munmap(dst_map, len);
-        close(fd_src);
-        close(fd_dst);
-        die("munmap(src)");
+    for (i = optind; i < argc - 1; i++) {
+        const char* dst = target;
+        if (to_dir) {
+            char tmp[PATH_MAX];
+            snprintf(tmp, sizeof(tmp), "%s", argv[i]);
+            if (snprintf(path, sizeof(path), "%s/%s", target, basename(tmp)) >= (int)sizeof(path)) {
+                fprintf(stderr, "%s: destination path too long\n", argv[i]);
+                status = EXIT_FAILURE;
+                continue;
+            }
+            dst = path;
+        }
+        if (copy_file(argv[i], dst, &o, &where) != 0) {
+            if (!to_dir)
+                die(where);
+            fprintf(stderr, "%s: %s: %s\n", argv[i], where, strerror(errno));
+            status = EXIT_FAILURE;
+        }
     }
-    if (munmap(dst_map, len) != 0) {
-        close(fd_src);
-        close(fd_dst);
-        die("munmap(dst)");
+
+    if (o.defer_sync) {
+        int fd = open(target, O_RDONLY | O_DIRECTORY);
+        t1 = o.bench ? now_sec() : 0;
+        if (fd < 0 || syncfs(fd) != 0) {
+            perror("syncfs(dst)");
+            status = EXIT_FAILURE;
+        }
+        if (fd >= 0)
+            close(fd);
+        if (o.bench)
+            o.flush_sec += now_sec() - t1;
     }
+    if (o.arena != NULL)
+        munmap(o.arena, SMALL_MAX);
 
-    if (close(fd_src) != 0)
-        die("close(src)");
-    if (fsync(fd_dst) != 0) {
-        close(fd_dst);
-        die("fsync(dst)");
+    if (o.bench) {
+        double t = now_sec() - t0;
+        static const char* const pf_name[] = { "none", "populate", "willneed" };
+        static const char* const fl_name[] = { "sync", "async" };
+        getrusage(RUSAGE_SELF, &ru1);
+        fprintf(stderr, "cp_mmap: %lld files, %lld bytes, %.3f s, %.1f MB/s, faults minor %ld major %ld,"
+                        " in memcpy minor %ld major %ld, flush %.3f s (prefault=%s, huge=%s, flush=%s,"
+                        " files mmap/cfr/rw %lld/%lld/%lld)\n",
+                o.files, o.bytes, t, t > 0 ? (double)o.bytes / 1e6 / t : 0.0,
+                ru1.ru_minflt - ru0.ru_minflt, ru1.ru_majflt - ru0.ru_majflt,
+                o.copy_minflt, o.copy_majflt, o.flush_sec,
+                pf_name[o.prefault], !o.huge ? "off" : o.huge_failed ? "refused" : "on",
+                fl_name[o.flush], o.by_engine[EN_MMAP], o.by_engine[EN_CFR], o.by_engine[EN_RW]);
     }
-    if (close(fd_dst) != 0)
-        die("close(dst)");
 
-    return EXIT_SUCCESS;
+    return status;
 }
\ No newline at end of file